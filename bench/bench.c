@@ -0,0 +1,462 @@
+#include <time.h>
+#include <errno.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <libubus.h>
+#include <libubox/uloop.h>
+#include <libubox/blobmsg.h>
+
+#include "../includes/helpers.h"
+#include "../includes/netdev.h"
+#include "../includes/diskstats.h"
+#include "../includes/procstat.h"
+#include "../includes/tsdb.h"
+#include "../includes/sampler.h"
+#include "../includes/defs.h"
+
+/* Upper bound of the pids cycled through by the pid_lookup benchmark */
+#define BENCH_MAX_PIDS      65536
+/* How long to wait for the ubm object to appear on the bus, in milliseconds */
+#define BENCH_UBUS_WAIT     5000
+
+/**
+ * @typedef bench_case
+ * @property {const char*} name - The name printed in the report.
+ * @property {void (*)(unsigned)} run - Performs a single operation, receives the iteration number.
+ * @property {unsigned} divisor - The iteration count is divided by it for expensive operations.
+ */
+typedef struct bench_case {
+    const char* name;
+    void (*run)(unsigned i);
+    unsigned divisor;
+} bench_case;
+
+/* Allocations are counted by wrapping the allocator at link time, see the Makefile */
+static unsigned long alloc_count = 0;
+static unsigned long alloc_bytes = 0;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t n, size_t size);
+void* __real_realloc(void* ptr, size_t size);
+
+void* __wrap_malloc(size_t size) {
+    alloc_count++;
+    alloc_bytes += size;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t n, size_t size) {
+    alloc_count++;
+    alloc_bytes += n * size;
+    return __real_calloc(n, size);
+}
+
+void* __wrap_realloc(void* ptr, size_t size) {
+    alloc_count++;
+    alloc_bytes += size;
+    return __real_realloc(ptr, size);
+}
+
+static arena bench_arena;
+static int* pids = NULL;
+static unsigned pid_count = 0;
+
+static uint64_t now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int u64_cmp(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return x < y ? -1 : x > y;
+}
+
+static void report_header(bool allocs) {
+    printf("%-28s %10s %12s %12s %12s", "benchmark", "ops", "ns/op", "p50 ns", "p99 ns");
+    if (allocs)
+        printf(" %10s %10s", "allocs/op", "bytes/op");
+    printf("\n");
+}
+
+static void report(const char* name, uint64_t* samples, unsigned n, bool allocs,
+    unsigned long count, unsigned long bytes)
+{
+    uint64_t total = 0;
+    for (unsigned i = 0; i < n; i++)
+        total += samples[i];
+    qsort(samples, n, sizeof(*samples), u64_cmp);
+
+    printf("%-28s %10u %12llu %12llu %12llu", name, n, (unsigned long long)(total / n),
+        (unsigned long long)samples[n / 2], (unsigned long long)samples[(uint64_t)n * 99 / 100]);
+    if (allocs)
+        printf(" %10.1f %10.0f", (double)count / n, (double)bytes / n);
+    printf("\n");
+}
+
+static void bench_cpu_info(unsigned i) {
+    arena_reset(&bench_arena);
+    get_cpu_info(&bench_arena);
+}
+
+static void bench_mem_info(unsigned i) {
+    arena_reset(&bench_arena);
+    get_mem_info(&bench_arena);
+}
+
+static void bench_netdev(unsigned i) {
+    netdev_sample();
+}
+
+static void bench_diskstats(unsigned i) {
+    diskstats_sample();
+}
+
+/* Once the budget is used up blocks are recycled, so appending stops allocating.
+ * Until then bytes/op is the compressed size of a sample. */
+static tsdb_series bench_series = { .name = "bench", .budget = 64 * 1024 };
+static uint64_t bench_noise = 88172645463325252ull;
+
+/* Samples look like a CPU utilisation: a jittered 1 s interval and a ratio of jiffies */
+static void bench_series_append(unsigned i) {
+    bench_noise ^= bench_noise << 13;
+    bench_noise ^= bench_noise >> 7;
+    bench_noise ^= bench_noise << 17;
+    uint64_t time_ms = 1700000000000ull + (uint64_t)i * 1000 + bench_noise % 5 - 2;
+    tsdb_append(&bench_series, time_ms, 100.0f * (float)((bench_noise >> 40) % 401) / 400.0f);
+}
+
+static void bench_pid_lookup(unsigned i) {
+    process proc;
+    if (pid_count > 0)
+        pid_lookup(pids[i % pid_count], &proc);
+}
+
+static void bench_current_users(unsigned i) {
+    get_current_users();
+}
+
+static void bench_process_top(unsigned i) {
+    static process_top top[TOP_DEFAULT_COUNT];
+    procstat_top(PROCSTAT_BY_CPU, TOP_DEFAULT_COUNT, top);
+}
+
+/* A name that never matches scans the whole process table without signalling anything */
+static void bench_process_scan(unsigned i) {
+    signal_result result;
+    send_signal_by_name("ubm-bench-none", 0, &result, 1);
+}
+
+static const bench_case cases[] = {
+    { .name = "get_cpu_info", .run = bench_cpu_info, .divisor = 1 },
+    { .name = "get_mem_info", .run = bench_mem_info, .divisor = 1 },
+    { .name = "netdev_sample", .run = bench_netdev, .divisor = 1 },
+    { .name = "diskstats_sample", .run = bench_diskstats, .divisor = 1 },
+    { .name = "tsdb_append", .run = bench_series_append, .divisor = 1 },
+    { .name = "pid_lookup", .run = bench_pid_lookup, .divisor = 1 },
+    { .name = "get_current_users", .run = bench_current_users, .divisor = 1 },
+    { .name = "process_table_scan", .run = bench_process_scan, .divisor = 100 },
+    { .name = "procstat_top", .run = bench_process_top, .divisor = 100 },
+};
+
+static void collect_pids() {
+    DIR* dir = opendir(procfs_root());
+    if (dir == NULL)
+        return;
+
+    pids = (int*) malloc(BENCH_MAX_PIDS * sizeof(int));
+    struct dirent* entry;
+    while (pids != NULL && pid_count < BENCH_MAX_PIDS && (entry = readdir(dir)) != NULL) {
+        int pid = atoi(entry->d_name);
+        if (pid > 0)
+            pids[pid_count++] = pid;
+    }
+    closedir(dir);
+}
+
+static int bench_collectors(unsigned iterations) {
+    uloop_init();
+    netdev_init();
+    diskstats_init();
+    tsdb_add(&bench_series);
+    collect_pids();
+
+    uint64_t* samples = (uint64_t*) malloc(iterations * sizeof(uint64_t));
+    if (samples == NULL)
+        return 1;
+
+    printf("procfs root %s, %u processes\n", procfs_root(), pid_count);
+    report_header(true);
+    for (unsigned c = 0; c < ARRAY_SIZE(cases); c++) {
+        unsigned n = iterations / cases[c].divisor;
+        if (n == 0)
+            n = 1;
+
+        /* warm up the persistent procfs buffers before measuring */
+        cases[c].run(0);
+        unsigned long count = alloc_count, bytes = alloc_bytes;
+        for (unsigned i = 0; i < n; i++) {
+            uint64_t start = now_ns();
+            cases[c].run(i);
+            samples[i] = now_ns() - start;
+        }
+        report(cases[c].name, samples, n, true, alloc_count - count, alloc_bytes - bytes);
+    }
+
+    free(samples);
+    free(pids);
+    arena_free(&bench_arena);
+    netdev_cleanup();
+    diskstats_cleanup();
+    tsdb_cleanup();
+    sampler_cleanup();
+    users_cleanup();
+    procstat_cleanup();
+    procfs_cleanup();
+    uloop_done();
+    return 0;
+}
+
+static int bench_ubus(const char* socket, unsigned iterations) {
+    static const char* methods[] = { "info", "cpu", "cpu_usage", "mem", "net", "disk", "series", "lookup", "top", "cache" };
+
+    struct ubus_context* ctx = ubus_connect(socket);
+    if (ctx == NULL) {
+        fprintf(stderr, "Failed to connect to ubusd at %s\n", socket ? socket : "the default socket");
+        return 1;
+    }
+
+    uint32_t id;
+    int waited = 0;
+    while (ubus_lookup_id(ctx, "ubm", &id) != 0) {
+        if (waited >= BENCH_UBUS_WAIT) {
+            fprintf(stderr, "The ubm object did not appear on the bus\n");
+            ubus_free(ctx);
+            return 1;
+        }
+        usleep(100 * 1000);
+        waited += 100;
+    }
+
+    uint64_t* samples = (uint64_t*) malloc(iterations * sizeof(uint64_t));
+    if (samples == NULL) {
+        ubus_free(ctx);
+        return 1;
+    }
+
+    struct blob_buf buf = { 0 };
+    report_header(false);
+    for (unsigned m = 0; m < ARRAY_SIZE(methods); m++) {
+        blob_buf_init(&buf, 0);
+        if (strcmp(methods[m], "lookup") == 0)
+            blobmsg_add_u32(&buf, "pid", 1);
+
+        char name[32];
+        snprintf(name, sizeof(name), "ubus %s", methods[m]);
+        unsigned n = 0;
+        for (unsigned i = 0; i < iterations; i++) {
+            uint64_t start = now_ns();
+            if (ubus_invoke(ctx, id, methods[m], buf.head, NULL, NULL, 1000) == 0)
+                samples[n++] = now_ns() - start;
+        }
+        if (n > 0)
+            report(name, samples, n, false, 0, 0);
+        else
+            printf("%-28s failed\n", name);
+    }
+
+    blob_buf_free(&buf);
+    free(samples);
+    ubus_free(ctx);
+    return 0;
+}
+
+static int write_file(const char* root, const char* name, const char* data) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", root, name);
+    FILE* f = fopen(path, "w");
+    if (f == NULL) {
+        fprintf(stderr, "Failed to write %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    fputs(data, f);
+    fclose(f);
+    return 0;
+}
+
+/* Writes a procfs tree shaped like a dual socket server with `cores` processors and `procs` processes */
+static int generate_fixture(const char* root, unsigned cores, unsigned procs) {
+    char path[PATH_MAX];
+    mkdir(root, 0755);
+    snprintf(path, sizeof(path), "%s/net", root);
+    mkdir(path, 0755);
+
+    size_t size = (cores + 1) * 2048 + 4096;
+    char* data = (char*) malloc(size);
+    if (data == NULL)
+        return -1;
+
+    size_t len = 0;
+    for (unsigned i = 0; i < cores; i++) {
+        len += snprintf(data + len, size - len,
+            "processor\t: %u\n"
+            "vendor_id\t: GenuineIntel\n"
+            "cpu family\t: 6\n"
+            "model\t\t: 85\n"
+            "model name\t: Intel(R) Xeon(R) Gold 6130 CPU @ 2.10GHz\n"
+            "stepping\t: 4\n"
+            "cpu MHz\t\t: 2100.000\n"
+            "cache size\t: 22528 KB\n"
+            "physical id\t: %u\n"
+            "siblings\t: %u\n"
+            "core id\t\t: %u\n"
+            "cpu cores\t: %u\n"
+            "fpu\t\t: yes\n"
+            "flags\t\t: fpu vme de pse tsc msr pae mce cx8 apic sep mtrr pge mca cmov pat pse36 "
+            "clflush mmx fxsr sse sse2 ss ht syscall nx pdpe1gb rdtscp lm constant_tsc pni pclmulqdq "
+            "ssse3 fma cx16 pcid sse4_1 sse4_2 x2apic movbe popcnt aes xsave avx f16c rdrand avx2 avx512f\n"
+            "bogomips\t: 4200.00\n"
+            "clflush size\t: 64\n"
+            "cache_alignment\t: 64\n"
+            "address sizes\t: 46 bits physical, 48 bits virtual\n"
+            "power management:\n\n",
+            i, i * 2 / (cores ? cores : 1), cores / 2, i % (cores / 2 ? cores / 2 : 1), cores / 2);
+    }
+    if (write_file(root, "cpuinfo", data) != 0)
+        goto fail;
+
+    len = snprintf(data, size, "cpu  4705 356 584 3699176 23 23 0 0 0 0\n");
+    for (unsigned i = 0; i < cores; i++)
+        len += snprintf(data + len, size - len, "cpu%u 1393 280 290 1495 12 0 10 0 0 0\n", i);
+    snprintf(data + len, size - len, "intr 114930548 113199788 3 0 5 263 0 4\nctxt 1990473\n"
+        "btime 1062191376\nprocesses 2915\nprocs_running 1\nprocs_blocked 0\n");
+    if (write_file(root, "stat", data) != 0)
+        goto fail;
+
+    if (write_file(root, "meminfo",
+            "MemTotal:       16318504 kB\nMemFree:         9523124 kB\nMemAvailable:   12944996 kB\n"
+            "Buffers:          224384 kB\nCached:          3285704 kB\nSwapCached:            0 kB\n"
+            "Active:          2766576 kB\nInactive:        3139876 kB\nActive(anon):    2403684 kB\n"
+            "Inactive(anon):        0 kB\nActive(file):     362892 kB\nInactive(file):  3139876 kB\n"
+            "Unevictable:       11840 kB\nMlocked:           11840 kB\nSwapTotal:       2097148 kB\n"
+            "SwapFree:        2097148 kB\nDirty:               444 kB\nWriteback:             0 kB\n"
+            "AnonPages:       2408064 kB\nMapped:           720548 kB\nShmem:             21264 kB\n"
+            "KReclaimable:     159944 kB\nSlab:             340592 kB\nSReclaimable:     159944 kB\n"
+            "SUnreclaim:       180648 kB\nKernelStack:       18976 kB\nPageTables:        41188 kB\n"
+            "CommitLimit:    10256400 kB\nCommitted_AS:    9231000 kB\nVmallocTotal:   34359738367 kB\n"
+            "VmallocUsed:       62528 kB\nHugePages_Total:       0\nHugePages_Free:        0\n"
+            "Hugepagesize:       2048 kB\nDirectMap4k:      472364 kB\nDirectMap2M:    11925504 kB\n") != 0)
+        goto fail;
+
+    if (write_file(root, "uptime", "350735.47 234388.90\n") != 0)
+        goto fail;
+
+    snprintf(data, size, "0.52 0.58 0.59 3/%u 12345\n", procs);
+    if (write_file(root, "loadavg", data) != 0)
+        goto fail;
+
+    if (write_file(root, "net/dev",
+            "Inter-|   Receive                                                |  Transmit\n"
+            " face |bytes    packets errs drop fifo frame compressed multicast|bytes    packets errs drop fifo colls carrier compressed\n"
+            "    lo: 36170966   14737    0    0    0     0          0         0 36170966   14737    0    0    0     0       0          0\n"
+            "  eth0: 9834021344 8210732    0   12    0     0          0      1043 1203398812 3923311    0    0    0     0       0          0\n"
+            "  eth1: 118312883  412093    0    0    0     0          0         0 84482020  301291    0    0    0     0       0          0\n"
+            "br-lan: 73221009  290133    0    0    0     0          0       201 98338123  310022    0    0    0     0       0          0\n"
+            " wlan0: 60039281  188410    3   41    0     0          0         0 91902771  240019    0    0    0     0       0          0\n") != 0)
+        goto fail;
+
+    if (write_file(root, "diskstats",
+            "   7       0 loop0 102 0 2548 31 0 0 0 0 0 44 31 0 0 0 0 0 0\n"
+            "   8       0 sda 181203 40211 12083412 93011 402912 301122 29304812 1002311 0 533120 1101203 0 0 0 0 12011 5872\n"
+            "   8       1 sda1 180011 40211 12071012 92871 402912 301122 29304812 1002311 0 532990 1095182 0 0 0 0 0 0\n"
+            " 179       0 mmcblk0 20311 1203 1120312 12031 8821 2011 301882 40211 0 30122 52301 0 0 0 0 0 0\n"
+            " 179       1 mmcblk0p1 20121 1203 1118120 11923 8821 2011 301882 40211 0 30011 52133 0 0 0 0 0 0\n"
+            " 254       0 zram0 1203 0 9624 12 4011 0 32088 40 0 52 52 0 0 0 0 0 0\n") != 0)
+        goto fail;
+
+    for (unsigned pid = 1; pid <= procs; pid++) {
+        snprintf(path, sizeof(path), "%s/%u", root, pid);
+        mkdir(path, 0755);
+        snprintf(data, size,
+            "%u (worker-%u) S %u %u %u 0 -1 4194560 1211 0 0 0 %u %u 0 0 20 0 1 0 %u 12681216 771 "
+            "18446744073709551615 1 1 0 0 0 0 0 4096 0 0 0 17 %u 0 0 0 0 0 0 0 0 0 0 0 0 0\n",
+            pid, pid, pid > 1 ? 1 + pid % 97 : 0, pid, pid, pid % 300, pid % 50, 100 + pid, pid % (cores ? cores : 1));
+        char stat[32];
+        snprintf(stat, sizeof(stat), "%u/stat", pid);
+        if (write_file(root, stat, data) != 0)
+            goto fail;
+    }
+
+    free(data);
+    return 0;
+
+fail:
+    free(data);
+    return -1;
+}
+
+static void usage(const char* name) {
+    fprintf(stderr, "Usage: %s [options]\n"
+        "  -r <dir>   procfs root to benchmark the collectors against (default /proc)\n"
+        "  -g <dir>   generate a fixture procfs root in <dir> and benchmark against it\n"
+        "  -c <n>     processors in the generated fixture (default 64)\n"
+        "  -p <n>     processes in the generated fixture (default 5000)\n"
+        "  -n <n>     iterations per benchmark (default 10000)\n"
+        "  -s <path>  measure ubus round trips through the ubusd socket instead\n"
+        "  -h         show this help\n",
+        name);
+}
+
+int main(int argc, char** argv) {
+    const char* root = NULL;
+    const char* fixture = NULL;
+    const char* socket = NULL;
+    unsigned cores = 64, procs = 5000, iterations = 10000;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "r:g:c:p:n:s:h")) != -1) {
+        switch (opt) {
+            case 'r':
+                root = optarg;
+                break;
+            case 'g':
+                fixture = optarg;
+                break;
+            case 'c':
+                cores = (unsigned)strtoul(optarg, NULL, 10);
+                break;
+            case 'p':
+                procs = (unsigned)strtoul(optarg, NULL, 10);
+                break;
+            case 'n':
+                iterations = (unsigned)strtoul(optarg, NULL, 10);
+                break;
+            case 's':
+                socket = optarg;
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (iterations == 0)
+        iterations = 1;
+
+    if (socket != NULL)
+        return bench_ubus(socket, iterations);
+
+    if (fixture != NULL) {
+        if (generate_fixture(fixture, cores, procs) != 0)
+            return 1;
+        root = fixture;
+    }
+    if (procfs_init(root) != 0)
+        return 1;
+    return bench_collectors(iterations);
+}
@@ -0,0 +1,27 @@
+#!/bin/sh
+# Measures ubus round trips of every ubm method against a private ubusd and UBMonitor instance.
+# Usage: ubus_bench.sh <UBMonitor> <ubm_bench> [ubm_bench options]
+
+BIN="$1"
+BENCH="$2"
+shift 2
+
+if ! command -v ubusd >/dev/null 2>&1; then
+    echo "ubusd not found, skipping the ubus round trips"
+    exit 0
+fi
+
+SOCK=$(mktemp -u /tmp/ubm-bench.XXXXXX)
+ubusd -s "$SOCK" &
+UBUSD=$!
+trap 'kill $UBM $UBUSD 2>/dev/null; rm -f "$SOCK"' EXIT INT TERM
+
+while [ ! -S "$SOCK" ]; do
+    sleep 0.1
+done
+
+# replies are not cached by default so every call measures collection as well
+"$BIN" -s "$SOCK" -t "${BENCH_TTL:-0}" &
+UBM=$!
+
+"$BENCH" -s "$SOCK" "$@"
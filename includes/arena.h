@@ -0,0 +1,72 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Smallest block requested from the allocator */
+#define ARENA_BLOCK_SIZE    4096
+/* Every allocation is aligned for any type */
+#define ARENA_ALIGN         _Alignof(max_align_t)
+
+/**
+ * @typedef arena_block
+ * @property {arena_block*} next - The previously filled block.
+ * @property {size_t} size - The usable size of the block.
+ * @property {size_t} used - The bytes handed out from the block.
+ * @note the usable memory follows the header.
+ */
+typedef struct arena_block {
+    struct arena_block* next;
+    size_t size;
+    size_t used;
+} arena_block;
+
+/**
+ * @typedef arena
+ * @property {arena_block*} blocks - The block allocations are served from, followed by the filled ones.
+ * @property {size_t} size - The usable size of all blocks.
+ * @property {size_t} used - The bytes handed out since the last reset.
+ * @property {size_t} peak - The most bytes handed out between two resets.
+ */
+typedef struct arena {
+    arena_block* blocks;
+    size_t size;
+    size_t used;
+    size_t peak;
+} arena;
+
+/**
+ * @brief Allocates memory from the arena, growing it by a new block if needed.
+ * @param a pointer to the `arena`.
+ * @param size the size of the allocation.
+ * @return a pointer to the uninitialised memory or `NULL` on failure.
+ * @note the memory stays valid until the next `arena_reset`.
+ */
+void* arena_alloc(arena* a, size_t size);
+
+/**
+ * @brief Allocates zeroed memory for an array from the arena.
+ * @param a pointer to the `arena`.
+ * @param n the number of elements, 0 still returns a valid pointer.
+ * @param size the size of an element.
+ * @return a pointer to the zeroed memory or `NULL` on failure.
+ */
+void* arena_calloc(arena* a, size_t n, size_t size);
+
+/**
+ * @brief Releases every allocation of the arena at once.
+ * @param a pointer to the `arena`.
+ * @note an arena that had to grow is merged into a single block, so it stops allocating once warm.
+ */
+void arena_reset(arena* a);
+
+/**
+ * @brief Frees all blocks of the arena.
+ * @param a pointer to the `arena`.
+ */
+void arena_free(arena* a);
+
+#endif // ARENA_H
@@ -0,0 +1,85 @@
+#ifndef CPU_USAGE_H
+#define CPU_USAGE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <stdbool.h>
+
+#include "procfs.h"
+#include "sampler.h"
+
+/**
+ * @typedef cpu_times
+ * @property {uint64_t} user - Jiffies spent in user mode, including niced tasks.
+ * @property {uint64_t} system - Jiffies spent in kernel mode.
+ * @property {uint64_t} idle - Jiffies spent idle.
+ * @property {uint64_t} iowait - Jiffies spent waiting for I/O.
+ * @property {uint64_t} irq - Jiffies spent servicing hard and soft interrupts.
+ * @property {uint64_t} steal - Jiffies stolen by the hypervisor.
+ */
+typedef struct cpu_times {
+    uint64_t user;
+    uint64_t system;
+    uint64_t idle;
+    uint64_t iowait;
+    uint64_t irq;
+    uint64_t steal;
+} cpu_times;
+
+/**
+ * @typedef cpu_load
+ * @property {unsigned} id - The CPU number, unused for the aggregate.
+ * @property {double} user - Percentage of time spent in user mode.
+ * @property {double} system - Percentage of time spent in kernel mode.
+ * @property {double} iowait - Percentage of time spent waiting for I/O.
+ * @property {double} irq - Percentage of time spent servicing interrupts.
+ * @property {double} steal - Percentage of time stolen by the hypervisor.
+ * @property {double} idle - Percentage of time spent idle.
+ * @property {double} usage - Percentage of time spent busy.
+ */
+typedef struct cpu_load {
+    unsigned id;
+    double user;
+    double system;
+    double iowait;
+    double irq;
+    double steal;
+    double idle;
+    double usage;
+} cpu_load;
+
+/**
+ * @typedef cpu_usage
+ * @property {bool} valid - Whether at least two samples were taken.
+ * @property {unsigned} sampled - Timestamp of the last sample.
+ * @property {cpu_load} total - Utilisation of all CPUs together.
+ * @property {unsigned} core_count - The number of entries in `cores`.
+ * @property {cpu_load*} cores - Utilisation of every online CPU.
+ */
+typedef struct cpu_usage {
+    bool valid;
+    unsigned sampled;
+    cpu_load total;
+    unsigned core_count;
+    cpu_load* cores;
+} cpu_usage;
+
+/**
+ * @brief Registers the CPU utilisation collector with the sampler.
+ */
+void cpu_usage_init();
+
+/**
+ * @brief Fetches the last computed CPU utilisation.
+ * @return a pointer to the sampled `cpu_usage`, owned by the collector and replaced on every sample.
+ */
+const cpu_usage* get_cpu_usage();
+
+/**
+ * @brief Frees the sampled CPU utilisation.
+ */
+void cpu_usage_cleanup();
+
+#endif // CPU_USAGE_H
@@ -0,0 +1,90 @@
+#ifndef CPUSTATE_H
+#define CPUSTATE_H
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <limits.h>
+#include <stdbool.h>
+
+#include "sampler.h"
+
+/* Size of the thermal zone types, including the terminating NUL */
+#define THERMAL_TYPE_LEN    32
+
+/**
+ * @typedef core_freq
+ * @property {unsigned} cpu - The logical CPU number.
+ * @property {int} fd - Persistent descriptor of `scaling_cur_freq`.
+ * @property {bool} valid - Whether the last read succeeded.
+ * @property {uint64_t} cur_khz - The current frequency in kHz.
+ * @property {uint64_t} min_khz - The lowest frequency of the hardware in kHz.
+ * @property {uint64_t} max_khz - The highest frequency of the hardware in kHz.
+ */
+typedef struct core_freq {
+    unsigned cpu;
+    int fd;
+    bool valid;
+    uint64_t cur_khz;
+    uint64_t min_khz;
+    uint64_t max_khz;
+} core_freq;
+
+/**
+ * @typedef thermal_zone
+ * @property {unsigned} zone - The thermal zone number.
+ * @property {char[THERMAL_TYPE_LEN]} type - The sensor type, e.g. `x86_pkg_temp` or `cpu-thermal`.
+ * @property {int} fd - Persistent descriptor of `temp`.
+ * @property {bool} valid - Whether the last read succeeded.
+ * @property {int64_t} temp_mc - The temperature in millidegrees Celsius.
+ */
+typedef struct thermal_zone {
+    unsigned zone;
+    char type[THERMAL_TYPE_LEN];
+    int fd;
+    bool valid;
+    int64_t temp_mc;
+} thermal_zone;
+
+/**
+ * @typedef cpu_state
+ * @property {unsigned} core_count - The number of entries in `cores`.
+ * @property {core_freq*} cores - The cores with a cpufreq policy, ordered by CPU number.
+ * @property {unsigned} zone_count - The number of entries in `zones`.
+ * @property {thermal_zone*} zones - The thermal zones, ordered by zone number.
+ * @property {unsigned} sampled - Timestamp of the last sample, 0 before the first one.
+ */
+typedef struct cpu_state {
+    unsigned core_count;
+    core_freq* cores;
+    unsigned zone_count;
+    thermal_zone* zones;
+    unsigned sampled;
+} cpu_state;
+
+/**
+ * @brief Opens the frequency and temperature files of every core and thermal zone
+ *        and registers their collector with the sampler.
+ * @param path root of sysfs or `NULL` for `/sys`.
+ * @return 0 on success, -1 on allocation failure.
+ * @note cores without cpufreq and systems without thermal zones simply report none.
+ */
+int cpustate_init(const char* path);
+
+/**
+ * @brief Fetches the frequencies and temperatures of the last sample.
+ * @return a pointer to the `cpu_state`.
+ */
+const cpu_state* get_cpu_state();
+
+/**
+ * @brief Closes the sysfs files.
+ */
+void cpustate_cleanup();
+
+#endif // CPUSTATE_H
@@ -3,11 +3,23 @@
 
 #include <stdbool.h>
 
-/* Maximum amount of CPUs to index */
-#define MAX_CPUS            2
-/* Maximum amount of network interfaces to index */
-#define MAX_NETINT          4
-/* Should UBMonitor preserve CPU data to save resources */
-#define PRESERVE_CPU_DATA   true
+/* Maximum amount of processes signalled by name in a single call */
+#define SIGNAL_MAX_MATCHES  256
+/* Default amount of processes returned by the top method */
+#define TOP_DEFAULT_COUNT   10
+/* Default sampling interval of the background collectors in milliseconds */
+#define SAMPLER_INTERVAL    1000
+/* Default time to live of cached method replies in milliseconds, 0 disables the cache */
+#define REPLY_CACHE_TTL     1000
+/* Default file the sample history is mapped from, an empty path disables it */
+#define HISTORY_PATH        "/tmp/ubm.history"
+/* Samples kept in the history file, an hour at the default interval */
+#define HISTORY_CAPACITY    3600
+/* Default and maximum amount of points returned by the history method */
+#define HISTORY_POINTS      60
+#define HISTORY_MAX_POINTS  1000
+/* Default memory budget of every in-memory series in KiB. Noisy metrics take 15 to 40 bits
+ * per sample, so this holds about a day of samples at the default interval */
+#define SERIES_BUDGET       512
 
 #endif // DEFINES_H
\ No newline at end of file
@@ -0,0 +1,101 @@
+#ifndef DISKSTATS_H
+#define DISKSTATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <limits.h>
+#include <stdbool.h>
+
+#include "procfs.h"
+#include "sampler.h"
+
+/* Size of the device names, including the terminating NUL */
+#define DISK_NAME_LEN       32
+/* Size of a sector as counted by /proc/diskstats, regardless of the device */
+#define DISK_SECTOR_SIZE    512
+/* Directory whose entries are the whole block devices */
+#define DISK_SYSFS_BLOCK    "/sys/block"
+
+/**
+ * @typedef disk_info
+ * @property {char[DISK_NAME_LEN]} name - The name of the block device.
+ * @property {uint64_t} reads - Completed read requests.
+ * @property {uint64_t} reads_merged - Read requests merged with an adjacent one.
+ * @property {uint64_t} sectors_read - Sectors read.
+ * @property {uint64_t} read_ms - Milliseconds spent reading.
+ * @property {uint64_t} writes - Completed write requests.
+ * @property {uint64_t} writes_merged - Write requests merged with an adjacent one.
+ * @property {uint64_t} sectors_written - Sectors written.
+ * @property {uint64_t} write_ms - Milliseconds spent writing.
+ * @property {uint64_t} in_flight - Requests currently in flight.
+ * @property {uint64_t} io_ms - Milliseconds the device had requests in flight.
+ * @property {uint64_t} weighted_io_ms - Milliseconds spent on requests, weighted by the requests in flight.
+ * @property {double} read_iops - Read requests per second.
+ * @property {double} write_iops - Write requests per second.
+ * @property {double} read_bps - Bytes read per second.
+ * @property {double} write_bps - Bytes written per second.
+ * @property {double} busy - Percentage of time the device had requests in flight.
+ */
+typedef struct disk_info {
+    char name[DISK_NAME_LEN];
+    uint64_t reads;
+    uint64_t reads_merged;
+    uint64_t sectors_read;
+    uint64_t read_ms;
+    uint64_t writes;
+    uint64_t writes_merged;
+    uint64_t sectors_written;
+    uint64_t write_ms;
+    uint64_t in_flight;
+    uint64_t io_ms;
+    uint64_t weighted_io_ms;
+    double read_iops;
+    double write_iops;
+    double read_bps;
+    double write_bps;
+    double busy;
+} disk_info;
+
+/**
+ * @typedef disk_table
+ * @property {unsigned} disk_count - The number of entries in `disks`.
+ * @property {disk_info*} disks - Contiguous array of the sampled devices.
+ * @property {bool} rates - Whether the rates were derived from a previous sample.
+ * @property {unsigned} sampled - Timestamp of the sample.
+ */
+typedef struct disk_table {
+    unsigned disk_count;
+    disk_info* disks;
+    bool rates;
+    unsigned sampled;
+} disk_table;
+
+/**
+ * @brief Registers the block device collector with the sampler.
+ * @note partitions and virtual devices such as loop, ram and zram devices are left out.
+ */
+void diskstats_init();
+
+/**
+ * @brief Samples the block devices, derives the rates from the previous sample and publishes the table.
+ * @note the sampler collects and publishes in two steps, this is only exposed for the benchmarks.
+ */
+void diskstats_sample();
+
+/**
+ * @brief Fetches the last sampled block device table.
+ * @return a pointer to the `disk_table` or `NULL` if no sample succeeded yet.
+ * @note the table is owned by the collector and replaced on every sample.
+ */
+const disk_table* get_disk_table();
+
+/**
+ * @brief Frees the block device tables.
+ */
+void diskstats_cleanup();
+
+#endif // DISKSTATS_H
@@ -0,0 +1,110 @@
+#ifndef FEEDS_H
+#define FEEDS_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <stdbool.h>
+#include <libubus.h>
+#include <libubox/blobmsg.h>
+
+#include "sampler.h"
+
+/* Maximum amount of metric groups a feed can publish */
+#define FEED_MAX_GROUPS     8
+/* Maximum amount of feed objects registered at once */
+#define FEED_MAX_FEEDS      32
+/* How long a feed waits for its first subscriber before it is removed, in milliseconds */
+#define FEED_GRACE          30000
+/* Size of the feed object names */
+#define FEED_NAME_LEN       24
+
+/**
+ * @typedef feed_group
+ * @property {const char*} name - The notification type the group is published under.
+ * @property {bool} relative - Whether the delta is a percentage of the last published value instead of an absolute difference.
+ * @property {bool (*)(struct blob_buf*, double*)} collect - Serialises the group into the buffer and stores the value
+ *           compared against the delta, returns `false` if nothing can be published.
+ */
+typedef struct feed_group {
+    const char* name;
+    bool relative;
+    bool (*collect)(struct blob_buf* buf, double* value);
+} feed_group;
+
+/**
+ * @typedef feed
+ * @property {struct ubus_object} obj - The ubus object clients subscribe to.
+ * @property {char[FEED_NAME_LEN]} name - The name of the ubus object.
+ * @property {unsigned} groups - Bitmask of the published groups, bit `n` is the `n`-th registered group.
+ * @property {unsigned} interval - Publishing interval in milliseconds.
+ * @property {unsigned} delta - The change required before a group is published again.
+ * @property {uint64_t} created - Monotonic timestamp of the feed creation in milliseconds.
+ * @property {uint64_t} published - Monotonic timestamp of the last publishing round in milliseconds.
+ * @property {bool} subscribed - Whether the feed ever had a subscriber.
+ * @property {unsigned} sent - Bitmask of the groups published at least once.
+ * @property {double[FEED_MAX_GROUPS]} last - The last published value of every group.
+ * @property {feed*} next - Next feed.
+ */
+typedef struct feed {
+    struct ubus_object obj;
+    char name[FEED_NAME_LEN];
+    unsigned groups;
+    unsigned interval;
+    unsigned delta;
+    uint64_t created;
+    uint64_t published;
+    bool subscribed;
+    unsigned sent;
+    double last[FEED_MAX_GROUPS];
+    struct feed* next;
+} feed;
+
+/**
+ * @brief Registers the metric groups and the publisher with the sampler.
+ * @param ctx UBus context the feed objects are added to.
+ * @param groups array of `count` metric groups, it has to outlive the publisher.
+ * @param count the amount of groups, at most `FEED_MAX_GROUPS`.
+ * @return 0 on success, -1 on failure.
+ * @note register the publisher after the collectors it reads from.
+ */
+int feeds_init(struct ubus_context* ctx, const feed_group* groups, unsigned count);
+
+/**
+ * @brief Looks up a metric group by name.
+ * @param name the name of the group.
+ * @return the index of the group or -1 if it does not exist.
+ */
+int feeds_group_index(const char* name);
+
+/**
+ * @brief Fetches the feed publishing the requested groups, creating it if needed.
+ * @param groups bitmask of the requested groups.
+ * @param interval publishing interval in milliseconds, raised to the sampling interval.
+ * @param delta the change required before a group is published again.
+ * @return a pointer to the `feed` or `NULL` on failure.
+ * @note clients requesting the same groups, interval and delta share a feed.
+ * @note a feed is removed once its last subscriber leaves or if nobody subscribes within `FEED_GRACE`.
+ */
+const feed* feeds_subscribe(unsigned groups, unsigned interval, unsigned delta);
+
+/**
+ * @brief Fetches the name of a registered metric group.
+ * @param index the index of the group.
+ * @return the name of the group.
+ */
+const char* feeds_group_name(unsigned index);
+
+/**
+ * @brief Fetches the amount of registered metric groups.
+ * @return the amount of groups.
+ */
+unsigned feeds_group_count();
+
+/**
+ * @brief Removes every feed object and frees the publisher buffers.
+ */
+void feeds_cleanup();
+
+#endif // FEEDS_H
@@ -0,0 +1,78 @@
+#ifndef FSUSAGE_H
+#define FSUSAGE_H
+
+#include <stdio.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <stdbool.h>
+#include <sys/statvfs.h>
+#include <libubox/uloop.h>
+
+#include "arena.h"
+#include "procfs.h"
+#include "sampler.h"
+
+/**
+ * @typedef fs_mount
+ * @property {const char*} target - The mount point.
+ * @property {const char*} source - The mounted device or pseudo source.
+ * @property {const char*} fstype - The filesystem type, including the subtype of FUSE mounts.
+ * @property {bool} valid - Whether the last `statvfs` succeeded and reported any blocks.
+ * @property {bool} readonly - Whether the filesystem is mounted read-only.
+ * @property {uint64_t} total - Size of the filesystem in bytes.
+ * @property {uint64_t} free - Free bytes, including the ones reserved for root.
+ * @property {uint64_t} available - Bytes available to unprivileged users.
+ * @property {uint64_t} inodes - Total inodes.
+ * @property {uint64_t} inodes_free - Free inodes.
+ * @property {double} used_percent - Used space in percent of the space usable by unprivileged users, like `df`.
+ * @property {double} inodes_percent - Used inodes in percent.
+ */
+typedef struct fs_mount {
+    const char* target;
+    const char* source;
+    const char* fstype;
+    bool valid;
+    bool readonly;
+    uint64_t total;
+    uint64_t free;
+    uint64_t available;
+    uint64_t inodes;
+    uint64_t inodes_free;
+    double used_percent;
+    double inodes_percent;
+} fs_mount;
+
+/**
+ * @typedef fs_table
+ * @property {unsigned} mount_count - The number of entries in `mounts`.
+ * @property {fs_mount*} mounts - The mounts in mountinfo order, hidden mounts left out.
+ * @property {unsigned} sampled - Timestamp of the last `statvfs` pass.
+ */
+typedef struct fs_table {
+    unsigned mount_count;
+    fs_mount* mounts;
+    unsigned sampled;
+} fs_table;
+
+/**
+ * @brief Registers the filesystem collector and watches the mount table for changes.
+ * @return 0 on success, -1 if changes cannot be watched and the mount table is parsed on every sample.
+ */
+int fsusage_init();
+
+/**
+ * @brief Fetches the filesystem usage of the last sample.
+ * @return a pointer to the `fs_table` or `NULL` if no sample succeeded yet.
+ * @note mounts without blocks such as proc or sysfs have `valid` cleared.
+ */
+const fs_table* get_fs_table();
+
+/**
+ * @brief Stops watching the mount table and frees it.
+ */
+void fsusage_cleanup();
+
+#endif // FSUSAGE_H
@@ -1,100 +1,212 @@
 #ifndef HELPERS_H
 #define HELPERS_H
 
+#include <time.h>
+#include <errno.h>
 #include <stdio.h>
+#include <dirent.h>
+#include <signal.h>
 #include <string.h>
 #include <net/if.h>
+#include <arpa/inet.h>
 #include <stdlib.h>
 #include <syslog.h>
 #include <stdbool.h>
-#include <ifaddrs.h>
+#include <unistd.h>
+#include <sys/syscall.h>
 #include <linux/if_link.h>
 #include <libubox/blobmsg.h>
 #include <libubox/blobmsg_json.h>
 
-/* Maximum amount of CPUs to index */
-#define MAX_CPUS            2
-/* Maximum amount of network interfaces to index */
-#define MAX_NETINT          4
+#include "arena.h"
+#include "procfs.h"
+#include "users.h"
+
+/* Sizes of the fixed string fields of `_cpu_info` */
+#define CPU_VENDOR_LEN      32
+#define CPU_MODEL_LEN       128
+#define CPU_ADDR_SIZES_LEN  64
 
 /**
  * @typedef _cpu_info
- * @property {char*} vendor - The vendor of the CPU.
- * @property {char*} model - The model of the CPU.
+ * @property {char[CPU_VENDOR_LEN]} vendor - The vendor of the CPU.
+ * @property {char[CPU_MODEL_LEN]} model - The model of the CPU.
  * @property {unsigned} cores - The number of cores.
  * @property {unsigned} cache_size - The size of the CPU cache.
  * @property {unsigned} cache_align - The cache alignment.
- * @property {double} cpu_mhz - The clock speed of the CPU in MHz.
- * @property {char*} address_sizes - The address sizes supported by the CPU.
+ * @property {char[CPU_ADDR_SIZES_LEN]} address_sizes - The address sizes supported by the CPU.
  * @property {unsigned} physical_id - The physical ID of the CPU.
  */
 typedef struct _cpu_info {
-    char* vendor;
-    char* model;
+    char vendor[CPU_VENDOR_LEN];
+    char model[CPU_MODEL_LEN];
     unsigned cores;
     unsigned cache_size;
     unsigned cache_align;
-    double cpu_mhz;
-    char* address_sizes;
+    char address_sizes[CPU_ADDR_SIZES_LEN];
     unsigned physical_id;
 } _cpu_info;
 
 /**
  * @typedef cpu_info
  * @property {unsigned} cpus_active - The number of active CPUs.
- * @property {_cpu_info*} cpus[MAX_CPUS] - Array of pointers to _cpu_info structures.
+ * @property {_cpu_info*} cpus - Contiguous array of `cpus_active` _cpu_info structures.
  */
 typedef struct cpu_info {
     unsigned cpus_active;
-    _cpu_info* cpus[MAX_CPUS];
+    _cpu_info* cpus;
 } cpu_info;
 
 /**
- * @typedef swap_info
- * @property {unsigned} swap_total - The total swap memory.
- * @property {unsigned} swap_free - The free swap memory.
- * @property {unsigned} swap_cached - The cached swap memory.
+ * @brief Fields of `/proc/meminfo` in the order the kernel prints them.
+ * @note values are in kB, except for the `HugePages_*` page counts.
  */
-typedef struct swap_info {
-    unsigned swap_total;
-    unsigned swap_free;
-    unsigned swap_cached;
-} swap_info;
+enum {
+    MEMINFO_MEM_TOTAL,
+    MEMINFO_MEM_FREE,
+    MEMINFO_MEM_AVAILABLE,
+    MEMINFO_BUFFERS,
+    MEMINFO_CACHED,
+    MEMINFO_SWAP_CACHED,
+    MEMINFO_ACTIVE,
+    MEMINFO_INACTIVE,
+    MEMINFO_ACTIVE_ANON,
+    MEMINFO_INACTIVE_ANON,
+    MEMINFO_ACTIVE_FILE,
+    MEMINFO_INACTIVE_FILE,
+    MEMINFO_UNEVICTABLE,
+    MEMINFO_MLOCKED,
+    MEMINFO_HIGH_TOTAL,
+    MEMINFO_HIGH_FREE,
+    MEMINFO_LOW_TOTAL,
+    MEMINFO_LOW_FREE,
+    MEMINFO_SWAP_TOTAL,
+    MEMINFO_SWAP_FREE,
+    MEMINFO_ZSWAP,
+    MEMINFO_ZSWAPPED,
+    MEMINFO_DIRTY,
+    MEMINFO_WRITEBACK,
+    MEMINFO_ANON_PAGES,
+    MEMINFO_MAPPED,
+    MEMINFO_SHMEM,
+    MEMINFO_KRECLAIMABLE,
+    MEMINFO_SLAB,
+    MEMINFO_SRECLAIMABLE,
+    MEMINFO_SUNRECLAIM,
+    MEMINFO_KERNEL_STACK,
+    MEMINFO_SHADOW_CALL_STACK,
+    MEMINFO_PAGE_TABLES,
+    MEMINFO_SEC_PAGE_TABLES,
+    MEMINFO_NFS_UNSTABLE,
+    MEMINFO_BOUNCE,
+    MEMINFO_WRITEBACK_TMP,
+    MEMINFO_COMMIT_LIMIT,
+    MEMINFO_COMMITTED_AS,
+    MEMINFO_VMALLOC_TOTAL,
+    MEMINFO_VMALLOC_USED,
+    MEMINFO_VMALLOC_CHUNK,
+    MEMINFO_PERCPU,
+    MEMINFO_HARDWARE_CORRUPTED,
+    MEMINFO_ANON_HUGE_PAGES,
+    MEMINFO_SHMEM_HUGE_PAGES,
+    MEMINFO_SHMEM_PMD_MAPPED,
+    MEMINFO_FILE_HUGE_PAGES,
+    MEMINFO_FILE_PMD_MAPPED,
+    MEMINFO_CMA_TOTAL,
+    MEMINFO_CMA_FREE,
+    MEMINFO_UNACCEPTED,
+    MEMINFO_HUGE_PAGES_TOTAL,
+    MEMINFO_HUGE_PAGES_FREE,
+    MEMINFO_HUGE_PAGES_RSVD,
+    MEMINFO_HUGE_PAGES_SURP,
+    MEMINFO_HUGEPAGESIZE,
+    MEMINFO_HUGETLB,
+    MEMINFO_DIRECT_MAP_4K,
+    MEMINFO_DIRECT_MAP_4M,
+    MEMINFO_DIRECT_MAP_2M,
+    MEMINFO_DIRECT_MAP_1G,
+    __MEMINFO_MAX
+};
+
+/* Selects every field of `memory_info` */
+#define MEMINFO_ALL         (~(uint64_t)0 >> (64 - __MEMINFO_MAX))
 
 /**
  * @typedef memory_info
- * @property {unsigned} memory_total - The total physical memory.
- * @property {unsigned} memory_free - The free physical memory.
- * @property {unsigned} memory_available - The available memory.
- * @property {unsigned} memory_cached - The cached memory.
- * @property {swap_info*} swap_memory - Pointer to swap_info structure.
+ * @property {uint64_t[__MEMINFO_MAX]} values - The value of every `MEMINFO_*` field.
+ * @property {uint64_t} present - Bitmask of the fields the running kernel reports.
  */
 typedef struct memory_info {
-    unsigned memory_total;
-    unsigned memory_free;
-    unsigned memory_available;
-    unsigned memory_cached;
-    swap_info* swap_memory;
+    uint64_t values[__MEMINFO_MAX];
+    uint64_t present;
 } memory_info;
 
+/**
+ * @typedef net_counters
+ * @property {uint64_t} rx_bytes - The number of bytes received.
+ * @property {uint64_t} tx_bytes - The number of bytes transmitted.
+ * @property {uint64_t} rx_packets - The number of packets received.
+ * @property {uint64_t} tx_packets - The number of packets transmitted.
+ * @property {uint64_t} rx_errors - The number of receive errors.
+ * @property {uint64_t} tx_errors - The number of transmit errors.
+ * @property {uint64_t} rx_dropped - The number of dropped incoming packets.
+ * @property {uint64_t} tx_dropped - The number of dropped outgoing packets.
+ */
+typedef struct net_counters {
+    uint64_t rx_bytes;
+    uint64_t tx_bytes;
+    uint64_t rx_packets;
+    uint64_t tx_packets;
+    uint64_t rx_errors;
+    uint64_t tx_errors;
+    uint64_t rx_dropped;
+    uint64_t tx_dropped;
+} net_counters;
+
 /**
  * @typedef _network
- * @property {char*} ni_name - The name of the network interface.
+ * @property {char[IFNAMSIZ]} ni_name - The name of the network interface.
  * @property {int} ni_flags - The flags associated with the network interface.
+ * @property {int} ni_index - The kernel index of the interface, 0 if unknown.
+ * @property {net_counters} stats - The traffic counters of the interface.
+ * @property {double} rx_bps - The receive rate in bits per second.
+ * @property {double} tx_bps - The transmit rate in bits per second.
  */
 typedef struct _network {
-    char* ni_name;
+    char ni_name[IFNAMSIZ];
     int ni_flags;
+    int ni_index;
+    net_counters stats;
+    double rx_bps;
+    double tx_bps;
 } _network;
 
+/**
+ * @typedef net_address
+ * @property {int} ni_index - The kernel index of the interface the address belongs to.
+ * @property {unsigned char} family - The address family, `AF_INET` or `AF_INET6`.
+ * @property {unsigned char} prefix_len - The length of the network prefix.
+ * @property {char[INET6_ADDRSTRLEN]} address - The address in presentation format.
+ */
+typedef struct net_address {
+    int ni_index;
+    unsigned char family;
+    unsigned char prefix_len;
+    char address[INET6_ADDRSTRLEN];
+} net_address;
+
 /**
  * @typedef network_info
  * @property {unsigned} interface_count - The number of network interfaces.
- * @property {_network*} interfaces[MAX_NETINT] - Array of pointers to _network structures.
+ * @property {_network*} interfaces - Contiguous array of `interface_count` _network structures.
+ * @property {unsigned} address_count - The number of addresses.
+ * @property {net_address*} addresses - Contiguous array of `address_count` addresses of all interfaces.
  */
 typedef struct network_info {
     unsigned interface_count;
-    _network* interfaces[MAX_NETINT];
+    _network* interfaces;
+    unsigned address_count;
+    net_address* addresses;
 } network_info;
 
 /**
@@ -104,34 +216,72 @@ typedef struct network_info {
  * @property {network_info*} network - Pointer to network_info structure.
  * @property {int} uptime - The system uptime.
  * @property {unsigned} requested - The requested data.
- * @property {char*} current_user - The name of the current user.
+ * @property {const user_list*} users - The logged in users, owned by the user cache.
  */
 typedef struct system_info {
     cpu_info* cpu;
     memory_info* memory;
     network_info* network;
-    char* current_user;
+    const user_list* users;
 } system_info;
 
+/**
+ * @typedef load_info
+ * @property {double} load1 - The load average over the last minute.
+ * @property {double} load5 - The load average over the last 5 minutes.
+ * @property {double} load15 - The load average over the last 15 minutes.
+ * @property {unsigned} running - The number of runnable tasks.
+ * @property {unsigned} total - The number of tasks in the system.
+ */
+typedef struct load_info {
+    double load1;
+    double load5;
+    double load15;
+    unsigned running;
+    unsigned total;
+} load_info;
+
 /**
  * @typedef process
  * @property {char[256]} process_name - The name of the process.
  * @property {char} state - The state of the process.
  * @property {unsigned} pid - The process ID.
  * @property {unsigned} ppid - The parent process ID.
+ * @property {unsigned} threads - The number of threads.
+ * @property {uint64_t} utime - Clock ticks spent in user mode.
+ * @property {uint64_t} stime - Clock ticks spent in kernel mode.
+ * @property {uint64_t} start_time - Clock ticks after boot the process was started at.
+ * @property {uint64_t} vsz - The virtual memory size in bytes.
+ * @property {uint64_t} rss - The resident set size in bytes.
  */
 typedef struct process {
     char process_name[256];
     char state;
     unsigned pid;
     unsigned ppid;
+    unsigned threads;
+    uint64_t utime;
+    uint64_t stime;
+    uint64_t start_time;
+    uint64_t vsz;
+    uint64_t rss;
 } process;
 
+/**
+ * @typedef signal_result
+ * @property {unsigned} pid - The process ID that was signalled.
+ * @property {int} error - 0 on success or the `errno` value of the failure.
+ */
+typedef struct signal_result {
+    unsigned pid;
+    int error;
+} signal_result;
+
 /**
  * @brief Fetches the current uptime.
- * @return the current uptime or error message
+ * @return the current uptime in seconds or -1 on failure.
  */
-char* get_uptime();
+long get_uptime();
 
 /**
  * @brief Fetches the current timestamp.
@@ -140,91 +290,98 @@ char* get_uptime();
 unsigned get_timestamp();
 
 /**
- * @brief Fetches information about active CPUs.
- * @return a pointer to the `cpu_info` structure or `NULL`.
- * @note the user is responsible for freeing the object.
+ * @brief Fetches the current value of the monotonic clock.
+ * @return the monotonic time in milliseconds.
  */
-cpu_info* get_cpu_info();
+uint64_t get_monotonic_ms();
 
 /**
- * @brief Fetches information about the memory.
- * @return a pointer to the `memory_info` structure or `NULL`.
- * @note the user is responsible for freeing the object.
+ * @brief Fetches the current wall clock time.
+ * @return the UNIX time in milliseconds.
  */
-memory_info* get_mem_info();
+uint64_t get_realtime_ms();
 
 /**
- * @brief Fetches information about network interfaces available.
- * @return a pointer to the `network_info` structure or `NULL`.
- * @note the user is responsible for freeing the object.
+ * @brief Fetches the load averages and task counts from `/proc/loadavg`.
+ * @param load pointer to the `load_info` structure to fill in.
+ * @return `true` on success, `false` otherwise.
  */
-network_info* get_net_info();
+bool get_load_info(load_info* load);
 
 /**
- * @brief Fetches the name of the current user.
- * @return a pointer to the current user's name string.
- * @note this function uses `strdup`, therefore the user is responsible for freeing the string after use.
- */
-char* get_current_user();
-
-/**
- * @brief Performs a blank initialization of the `system_info` structure.
- * @param s double pointer to the system_info structure.
+ * @brief Fetches information about active CPUs.
+ * @param a the arena the structure is allocated from.
+ * @return a pointer to the `cpu_info` structure or `NULL`.
+ * @note the object lives until the arena is reset.
  */
-void blank_sysinf_init(system_info** s);
+cpu_info* get_cpu_info(arena* a);
 
 /**
- * @brief Fetches all the essential information about the system.
- * @return a pointer to the `system_info` structure or `NULL`.
- * @note the user is responsible for freeing the object.
+ * @brief Fetches information about the memory.
+ * @param a the arena the structure is allocated from.
+ * @return a pointer to the `memory_info` structure or `NULL`.
+ * @note the object lives until the arena is reset.
  */
-system_info* get_system_info_obj();
+memory_info* get_mem_info(arena* a);
 
 /**
- * @brief Fetches all the essential information about the system.
- * @param s double pointer to the `system_info` structure.
- * @note the user has to provide a double pointer to the `system_info` structure.
+ * @brief Looks up a `/proc/meminfo` field by the name the kernel prints.
+ * @param name the name of the field, e.g. `SReclaimable`.
+ * @return one of the `MEMINFO_*` fields or -1 if the name is unknown.
  */
-void get_system_info(system_info** s);
+int meminfo_field(const char* name);
 
 /**
- * @brief Fetches information about a specific process.
- * @param pid the process ID to look up.
- * @return a pointer to the newly created `process` structure or `NULL`.
+ * @brief Fetches the name the kernel prints for a `/proc/meminfo` field.
+ * @param field one of the `MEMINFO_*` fields.
+ * @return the name of the field.
  */
-process* pid_lookup(int pid);
+const char* meminfo_name(unsigned field);
 
 /**
- * @brief Sends a signal to a specific process.
- * @param pid process ID.
- * @param signal_id ID of the signal.
- * @return a string status message or `NULL`.
- * @note the user is responsible for freeing the string.
+ * @brief Fetches information and traffic counters of the network interfaces available.
+ * @param a the arena the structure is allocated from.
+ * @return a pointer to the `network_info` structure or `NULL`.
+ * @note the data comes from the last sample of the interface table.
+ * @note the object lives until the arena is reset.
  */
-char* send_signal(int pid, int signal_id);
+network_info* get_net_info(arena* a);
 
 /**
- * @brief Cleans up the whole `cpu_info` object, rendering it unusable.
- * @param c double pointer to the `cpu_info` structure.
+ * @brief Fetches information about a specific process from `/proc/<pid>/stat`.
+ * @param pid the process ID to look up.
+ * @param proc pointer to the `process` structure to fill in.
+ * @return `true` if the process was found, `false` otherwise.
  */
-void cpuinf_cleanup(cpu_info** c);
+bool pid_lookup(int pid, process* proc);
 
 /**
- * @brief Cleans up the `memory_info` object.
- * @param m double pointer to the `memory_info` structure.
+ * @brief Parses the contents of `/proc/<pid>/stat`.
+ * @param pid the process ID the contents were read for.
+ * @param buffer the NUL-terminated contents.
+ * @param proc pointer to the `process` structure to fill in.
+ * @return `true` on success, `false` if the contents are malformed.
  */
-void meminf_cleanup(memory_info** m);
+bool pid_stat_parse(int pid, const char* buffer, process* proc);
 
 /**
- * @brief Cleans up the `network_info` object.
- * @param n double pointer to the `network_info` structure.
+ * @brief Sends a signal to a specific process.
+ * @param pid process ID.
+ * @param signal_id ID of the signal.
+ * @return 0 on success or an `errno` value on failure.
+ * @note a pidfd is used when the kernel supports it, falling back to `kill()`.
  */
-void netinf_cleanup(network_info** n);
+int send_signal(int pid, int signal_id);
 
 /**
- * @brief Cleans up the whole `system_info` object.
- * @param s double pointer to the `system_info` structure.
+ * @brief Sends a signal to every process with the given name.
+ * @param name the process name as found in `/proc/<pid>/stat`.
+ * @param signal_id ID of the signal.
+ * @param results array receiving the result for every matched process.
+ * @param max capacity of the `results` array, no more processes are signalled.
+ * @return the amount of processes matched.
+ * @note UBMonitor never signals itself.
  */
-void sysinf_cleanup(system_info** s);
+unsigned send_signal_by_name(const char* name, int signal_id, signal_result* results, unsigned max);
 
 #endif // HELPERS_H
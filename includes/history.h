@@ -0,0 +1,102 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <time.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/* "UBMH" in little endian, marks an initialised history file */
+#define HISTORY_MAGIC       0x484d4255u
+/* Bumped whenever the layout of the header or of a record changes */
+#define HISTORY_VERSION     1
+
+/**
+ * @typedef history_record
+ * @property {uint64_t} seq - One past the sequence number of the record, 0 while it is written.
+ * @property {uint64_t} time_ms - Wall clock time of the sample in milliseconds.
+ * @property {float} cpu_usage - Total CPU utilisation in percent.
+ * @property {float} mem_used - Memory in use in percent of the total, based on `MemAvailable`.
+ * @property {float} rx_bps - Combined receive rate of all interfaces in bits per second.
+ * @property {float} tx_bps - Combined transmit rate of all interfaces in bits per second.
+ * @property {float} load1 - 1 minute load average.
+ * @property {float} load5 - 5 minute load average.
+ * @property {float} load15 - 15 minute load average.
+ * @property {uint32_t} tasks - The number of tasks.
+ */
+typedef struct history_record {
+    uint64_t seq;
+    uint64_t time_ms;
+    float cpu_usage;
+    float mem_used;
+    float rx_bps;
+    float tx_bps;
+    float load1;
+    float load5;
+    float load15;
+    uint32_t tasks;
+} history_record;
+
+/**
+ * @typedef history_header
+ * @property {uint32_t} magic - `HISTORY_MAGIC`, written last when the file is initialised.
+ * @property {uint32_t} version - `HISTORY_VERSION`.
+ * @property {uint32_t} record_size - Size of a record, guards against layout changes.
+ * @property {uint32_t} capacity - The number of record slots following the header.
+ * @property {uint64_t} head - Sequence number of the next record, advanced after it was written.
+ * @note padded to a cache line so the records stay aligned.
+ */
+typedef struct history_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t capacity;
+    uint64_t head;
+    uint8_t reserved[40];
+} history_header;
+
+/**
+ * @brief Maps the history file, creating or resetting it if its layout does not match.
+ * @param path path of the file, on tmpfs it survives daemon restarts and on flash also reboots.
+ * @param capacity the number of samples kept.
+ * @return 0 on success, -1 if no history is recorded.
+ * @note records committed before a crash are recovered even if the cursor was not advanced.
+ */
+int history_init(const char* path, unsigned capacity);
+
+/**
+ * @brief Appends a sample, overwriting the oldest one once the file is full.
+ * @param record the metrics and wall clock time to store, `seq` is filled in.
+ */
+void history_append(const history_record* record);
+
+/**
+ * @brief Fetches the sequence numbers of the stored records.
+ * @param first receives the sequence number of the oldest record.
+ * @param end receives the sequence number following the newest record.
+ * @return false if no history is mapped.
+ */
+bool history_bounds(uint64_t* first, uint64_t* end);
+
+/**
+ * @brief Fetches a record straight from the mapping.
+ * @param seq sequence number between the bounds of `history_bounds`.
+ * @return a pointer into the mapping or `NULL` if the record was overwritten.
+ * @note the record stays valid until the next `history_append`.
+ */
+const history_record* history_at(uint64_t seq);
+
+/**
+ * @brief Writes the mapping back and unmaps it.
+ */
+void history_cleanup();
+
+#endif // HISTORY_H
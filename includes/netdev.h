@@ -0,0 +1,67 @@
+#ifndef NETDEV_H
+#define NETDEV_H
+
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <libubox/uloop.h>
+
+#include "helpers.h"
+#include "sampler.h"
+
+/* Size of the buffer receiving rtnetlink dumps and notifications */
+#define NETDEV_BUFFER_SIZE  32768
+
+/**
+ * @brief Kinds of interface table changes reported to the change callback.
+ */
+enum {
+    NETDEV_CHANGED,
+    NETDEV_LINK_UP,
+    NETDEV_LINK_DOWN,
+    NETDEV_REMOVED,
+};
+
+/**
+ * @brief Callback invoked whenever the interface table is patched.
+ * @param net the interface that changed, its data is only valid during the call.
+ * @param change one of the `NETDEV_*` change kinds.
+ */
+typedef void (*netdev_change_cb)(const _network* net, int change);
+
+/**
+ * @brief Opens the rtnetlink sockets, subscribes to link and address notifications
+ *        and registers the interface collector with the sampler.
+ * @return 0 on success, -1 if only `/proc/net/dev` can be used.
+ * @note a procfs root other than `/proc` is always read through its `net/dev`.
+ * @note requires `uloop_init` to have been called.
+ */
+int netdev_init();
+
+/**
+ * @brief Samples the interfaces, derives the rates from the previous sample and publishes the table.
+ * @note the sampler collects and publishes in two steps, this is only exposed for the benchmarks.
+ */
+void netdev_sample();
+
+/**
+ * @brief Sets the callback invoked on interface table changes.
+ * @param cb the callback or `NULL`.
+ */
+void netdev_set_change_cb(netdev_change_cb cb);
+
+/**
+ * @brief Fetches the interface table.
+ * @return a pointer to the `network_info` table or `NULL` if no sample succeeded yet.
+ * @note the table is owned by the collector, it is patched by notifications and replaced on every sample.
+ */
+const network_info* get_netdev_table();
+
+/**
+ * @brief Closes the rtnetlink sockets and frees the interface table.
+ */
+void netdev_cleanup();
+
+#endif // NETDEV_H
@@ -0,0 +1,104 @@
+#ifndef PRESSURE_H
+#define PRESSURE_H
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <sys/epoll.h>
+#include <libubox/uloop.h>
+
+#include "procfs.h"
+
+/* Stall time in microseconds within the window that wakes the daemon */
+#define PSI_TRIGGER_STALL   300000
+/* Window of the PSI triggers in microseconds, the kernel fires at most once per window.
+ * Without CAP_SYS_RESOURCE only multiples of 2 seconds are accepted. */
+#define PSI_TRIGGER_WINDOW  2000000
+
+enum {
+    PRESSURE_CPU,
+    PRESSURE_MEMORY,
+    PRESSURE_IO,
+    __PRESSURE_MAX
+};
+
+/**
+ * @typedef pressure_avg
+ * @property {double} avg10 - Percentage of time stalled over the last 10 seconds.
+ * @property {double} avg60 - Percentage of time stalled over the last 60 seconds.
+ * @property {double} avg300 - Percentage of time stalled over the last 300 seconds.
+ * @property {uint64_t} total - Total stall time in microseconds.
+ */
+typedef struct pressure_avg {
+    double avg10;
+    double avg60;
+    double avg300;
+    uint64_t total;
+} pressure_avg;
+
+/**
+ * @typedef pressure_info
+ * @property {pressure_avg} some - Time at least one task was stalled on the resource.
+ * @property {pressure_avg} full - Time all non-idle tasks were stalled on the resource.
+ * @property {bool} has_full - Whether the kernel reports `full`, older kernels lack it for the CPU.
+ */
+typedef struct pressure_info {
+    pressure_avg some;
+    pressure_avg full;
+    bool has_full;
+} pressure_info;
+
+/**
+ * @typedef pressure_stall_cb
+ * @brief Callback invoked when a PSI trigger fires.
+ * @param resource one of the `PRESSURE_*` identifiers.
+ */
+typedef void (*pressure_stall_cb)(int resource);
+
+/**
+ * @brief Checks for PSI support and registers a trigger on every resource.
+ * @return 0 on success, -1 if PSI is not available or no trigger could be registered.
+ * @note requires `uloop_init` to have been called.
+ */
+int pressure_init();
+
+/**
+ * @brief Sets the callback invoked when a trigger fires.
+ * @param cb the callback or `NULL`.
+ */
+void pressure_set_stall_cb(pressure_stall_cb cb);
+
+/**
+ * @brief Reads the pressure of a resource.
+ * @param resource one of the `PRESSURE_*` identifiers.
+ * @param info pointer to the `pressure_info` to fill.
+ * @return true on success, false if PSI is not available.
+ */
+bool get_pressure(int resource, pressure_info* info);
+
+/**
+ * @brief Names a resource like its file in /proc/pressure.
+ * @param resource one of the `PRESSURE_*` identifiers.
+ * @return the name or `NULL`.
+ */
+const char* pressure_name(int resource);
+
+/**
+ * @brief Whether a trigger is registered for a resource.
+ * @param resource one of the `PRESSURE_*` identifiers.
+ */
+bool pressure_triggered(int resource);
+
+/**
+ * @brief Unregisters the triggers.
+ */
+void pressure_cleanup();
+
+#endif // PRESSURE_H
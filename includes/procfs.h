@@ -0,0 +1,110 @@
+#ifndef PROCFS_H
+#define PROCFS_H
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <limits.h>
+
+/* Initial size of a procfs read buffer, grown on demand */
+#define PROCFS_BUFFER_SIZE  4096
+
+/**
+ * @brief procfs files kept open for the lifetime of the daemon.
+ */
+enum {
+    PROCFS_MEMINFO,
+    PROCFS_UPTIME,
+    PROCFS_STAT,
+    PROCFS_CPUINFO,
+    PROCFS_LOADAVG,
+    PROCFS_NET_DEV,
+    PROCFS_DISKSTATS,
+    PROCFS_MOUNTINFO,
+    PROCFS_PRESSURE_CPU,
+    PROCFS_PRESSURE_MEMORY,
+    PROCFS_PRESSURE_IO,
+    __PROCFS_MAX
+};
+
+/**
+ * @brief Initializes the procfs reader.
+ * @param root path to the procfs mount or `NULL` for `/proc`.
+ * @return 0 on success, -1 on failure.
+ */
+int procfs_init(const char* root);
+
+/**
+ * @brief Returns the procfs root the reader was initialized with.
+ * @return the procfs root path, `/proc` by default.
+ */
+const char* procfs_root();
+
+/**
+ * @brief Rereads one of the persistent procfs files.
+ * @param file one of the `PROCFS_*` identifiers.
+ * @param len optional pointer receiving the amount of bytes read.
+ * @return a pointer to the NUL-terminated contents or `NULL`.
+ * @note the buffer is owned by the reader and is overwritten by the next read of the same file.
+ */
+const char* procfs_read(int file, size_t* len);
+
+/**
+ * @brief Opens one of the persistent procfs files without reading it.
+ * @param file one of the `PROCFS_*` identifiers.
+ * @return the file descriptor or -1 on failure.
+ * @note the descriptor stays owned by the reader, it may be polled but must not be closed.
+ */
+int procfs_fd(int file);
+
+/**
+ * @brief Reads a per-process procfs file such as `/proc/<pid>/stat` in one go.
+ * @param pid process ID.
+ * @param name name of the file inside the process directory.
+ * @param buf destination buffer, NUL-terminated on success.
+ * @param size size of the destination buffer.
+ * @return the amount of bytes read or -1 on failure.
+ */
+ssize_t procfs_read_pid(int pid, const char* name, char* buf, size_t size);
+
+/**
+ * @brief Closes all persistent procfs files and frees their buffers.
+ */
+void procfs_cleanup();
+
+/**
+ * @brief Advances to the beginning of the next line.
+ * @param p pointer into a NUL-terminated buffer.
+ * @return a pointer to the next line or to the terminating NUL.
+ */
+const char* procfs_next_line(const char* p);
+
+/**
+ * @brief Parses an unsigned decimal number, skipping leading blanks.
+ * @param p cursor into a NUL-terminated buffer, advanced past the number.
+ * @return the parsed value or 0 if no digits were found.
+ */
+uint64_t procfs_scan_u64(const char** p);
+
+/**
+ * @brief Matches a `key : value` line as found in `/proc/meminfo` and `/proc/cpuinfo`.
+ * @param line pointer to the beginning of a line.
+ * @param key the key to match.
+ * @return a pointer to the value or `NULL` if the line holds a different key.
+ */
+const char* procfs_field(const char* line, const char* key);
+
+/**
+ * @brief Copies a value up to the end of its line.
+ * @param dst destination buffer.
+ * @param size size of the destination buffer.
+ * @param value pointer to the value, as returned by `procfs_field`.
+ */
+void procfs_copy_value(char* dst, size_t size, const char* value);
+
+#endif // PROCFS_H
@@ -0,0 +1,125 @@
+#ifndef PROCSTAT_H
+#define PROCSTAT_H
+
+#include <time.h>
+#include <stdio.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <sys/syscall.h>
+
+#include "procfs.h"
+#include "helpers.h"
+
+/* Initial amount of slots of the per-process history, grown on demand */
+#define PROCSTAT_MIN_SLOTS  256
+/* How long the history of a process not seen by a scan is kept, in milliseconds */
+#define PROCSTAT_EXPIRE     60000
+/* Maximum amount of processes returned by a single `procstat_top` call */
+#define PROCSTAT_TOP_MAX    100
+/* Size of the buffer the procfs directory entries are read into */
+#define PROCSTAT_DENTS_SIZE 32768
+
+/**
+ * @brief Orderings of `procstat_top`.
+ */
+enum {
+    PROCSTAT_BY_CPU,
+    PROCSTAT_BY_RSS,
+    PROCSTAT_BY_IO,
+    __PROCSTAT_BY_MAX
+};
+
+/**
+ * @typedef process_io
+ * @property {uint64_t} rchar - Bytes read through read-like system calls.
+ * @property {uint64_t} wchar - Bytes written through write-like system calls.
+ * @property {uint64_t} read_bytes - Bytes fetched from the storage layer.
+ * @property {uint64_t} write_bytes - Bytes sent to the storage layer.
+ * @property {uint64_t} cancelled_write_bytes - Bytes not written back after all, e.g. truncated dirty pages.
+ */
+typedef struct process_io {
+    uint64_t rchar;
+    uint64_t wchar;
+    uint64_t read_bytes;
+    uint64_t write_bytes;
+    uint64_t cancelled_write_bytes;
+} process_io;
+
+/**
+ * @typedef process_top
+ * @property {process} proc - The process as parsed from `/proc/<pid>/stat`.
+ * @property {double} cpu_percent - CPU utilisation since the previous scan, in percent of a single CPU.
+ * @property {double} io_rate - Bytes per second read from and written to storage, only computed when ordering by I/O.
+ */
+typedef struct process_top {
+    process proc;
+    double cpu_percent;
+    double io_rate;
+} process_top;
+
+/**
+ * @brief Callback invoked for every process found by `procstat_scan`.
+ * @param proc the process, only valid during the call.
+ * @param priv the pointer passed to `procstat_scan`.
+ */
+typedef void (*procstat_scan_cb)(const process* proc, void* priv);
+
+/**
+ * @brief Computes the CPU utilisation of a process since it was last looked at.
+ * @param proc the process as filled in by `pid_lookup`.
+ * @return the utilisation in percent of a single CPU, may exceed 100 for multithreaded processes.
+ * @note the first lookup of a process reports its average utilisation since it was started.
+ */
+double procstat_cpu_percent(const process* proc);
+
+/**
+ * @brief Reads `/proc/<pid>/stat` of every process.
+ * @param cb callback invoked for every process that could be read.
+ * @param priv pointer passed on to the callback.
+ * @return the amount of processes passed to the callback.
+ */
+unsigned procstat_scan(procstat_scan_cb cb, void* priv);
+
+/**
+ * @brief Scans every process and returns the ones using the most of a resource.
+ * @param by one of the `PROCSTAT_BY_*` orderings.
+ * @param count the amount of processes to return, at most `PROCSTAT_TOP_MAX`.
+ * @param top destination array of at least `count` entries, filled in descending order.
+ * @return the amount of processes stored in `top`.
+ * @note utilisation and rates are measured since the previous scan or lookup of the same process.
+ */
+unsigned procstat_top(int by, unsigned count, process_top* top);
+
+/**
+ * @brief Converts the start time of a process to a UNIX timestamp.
+ * @param proc the process as filled in by `pid_lookup`.
+ * @return the time the process was started at.
+ */
+unsigned procstat_started(const process* proc);
+
+/**
+ * @brief Counts the open file descriptors of a process.
+ * @param pid process ID.
+ * @return the amount of open file descriptors or -1 on failure.
+ */
+int procstat_fd_count(int pid);
+
+/**
+ * @brief Reads the I/O counters of a process from `/proc/<pid>/io`.
+ * @param pid process ID.
+ * @param io pointer to the `process_io` structure to fill in.
+ * @return `true` on success, `false` if the counters are not accessible.
+ */
+bool procstat_io(int pid, process_io* io);
+
+/**
+ * @brief Frees the per-process history and closes the procfs directory.
+ */
+void procstat_cleanup();
+
+#endif // PROCSTAT_H
@@ -0,0 +1,82 @@
+#ifndef PTREE_H
+#define PTREE_H
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
+#include <libubox/uloop.h>
+
+#include "helpers.h"
+#include "procstat.h"
+
+/* Initial amount of slots of the process index, grown on demand */
+#define PTREE_MIN_SLOTS     512
+/* Deepest level of the process tree serialised below the requested process */
+#define PTREE_MAX_DEPTH     128
+/* Size of the buffer receiving process connector events */
+#define PTREE_BUFFER_SIZE   8192
+
+/**
+ * @brief Subscribes to process connector events and builds the process index.
+ * @return 0 on success, -1 if the index has to be rebuilt on every `ptree_update`.
+ * @note requires `uloop_init` to have been called, subscribing requires `CAP_NET_ADMIN`.
+ */
+int ptree_init();
+
+/**
+ * @brief Brings the process index up to date.
+ * @param cb callback invoked for every process of a single `procstat_scan`, `NULL` to skip the scan if possible.
+ * @param priv pointer passed on to the callback.
+ * @return `true` if the index can be walked, `false` if the process scan failed.
+ * @note without process connector events, or after they overflowed, the index is rebuilt from the same scan.
+ */
+bool ptree_update(procstat_scan_cb cb, void* priv);
+
+/**
+ * @brief Checks whether a process is part of the index.
+ * @param pid process ID.
+ * @return `true` if the process is indexed.
+ */
+bool ptree_contains(unsigned pid);
+
+/**
+ * @brief Fetches the indexed parent of a process.
+ * @param pid process ID.
+ * @return the process ID of the parent or 0 if it is not indexed.
+ */
+unsigned ptree_parent(unsigned pid);
+
+/**
+ * @brief Fetches the first child of a process.
+ * @param pid process ID, 0 for the processes without an indexed parent such as `init` and `kthreadd`.
+ * @return the process ID of the first child or 0 if there is none.
+ */
+unsigned ptree_first_child(unsigned pid);
+
+/**
+ * @brief Fetches the next sibling of a process.
+ * @param pid process ID.
+ * @return the process ID of the next child of the same parent or 0 if there is none.
+ */
+unsigned ptree_next_sibling(unsigned pid);
+
+/**
+ * @brief Fetches the amount of indexed processes.
+ * @return the amount of processes.
+ */
+unsigned ptree_count();
+
+/**
+ * @brief Unsubscribes from process connector events and frees the process index.
+ */
+void ptree_cleanup();
+
+#endif // PTREE_H
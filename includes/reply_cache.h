@@ -0,0 +1,86 @@
+#ifndef REPLY_CACHE_H
+#define REPLY_CACHE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <stdbool.h>
+#include <libubus.h>
+#include <libubox/blobmsg.h>
+
+/**
+ * @typedef reply_cache
+ * @property {const char*} name - The name of the cached method.
+ * @property {unsigned} ttl - How long a reply is served from the cache in milliseconds, 0 disables caching.
+ * @property {struct blob_attr*} reply - The serialised reply or `NULL`.
+ * @property {size_t} capacity - The size of the `reply` allocation.
+ * @property {uint64_t} stored - Monotonic timestamp of the stored reply in milliseconds.
+ * @property {bool} valid - Whether `reply` may be served.
+ * @property {unsigned} hits - The number of requests served from the cache.
+ * @property {unsigned} misses - The number of requests that had to be collected.
+ * @property {reply_cache*} next - Next registered cache.
+ */
+typedef struct reply_cache {
+    const char* name;
+    unsigned ttl;
+    struct blob_attr* reply;
+    size_t capacity;
+    uint64_t stored;
+    bool valid;
+    unsigned hits;
+    unsigned misses;
+    struct reply_cache* next;
+} reply_cache;
+
+/**
+ * @brief Registers a reply cache so it can be looked up and invalidated by name.
+ * @param c pointer to a statically allocated `reply_cache`.
+ * @param ttl time to live of a stored reply in milliseconds.
+ */
+void reply_cache_register(reply_cache* c, unsigned ttl);
+
+/**
+ * @brief Sends the cached reply if it is still fresh.
+ * @param c pointer to the `reply_cache`.
+ * @param ctx UBus context.
+ * @param req the request to reply to.
+ * @return `true` if the request was served from the cache, `false` on a miss.
+ */
+bool reply_cache_send(reply_cache* c, struct ubus_context* ctx, struct ubus_request_data* req);
+
+/**
+ * @brief Stores a serialised reply.
+ * @param c pointer to the `reply_cache`.
+ * @param reply the reply, usually the head of the shared `blob_buf`.
+ */
+void reply_cache_store(reply_cache* c, struct blob_attr* reply);
+
+/**
+ * @brief Drops the stored reply so the next request collects fresh data.
+ * @param c pointer to the `reply_cache`.
+ */
+void reply_cache_invalidate(reply_cache* c);
+
+/**
+ * @brief Drops the stored replies of all registered caches.
+ */
+void reply_cache_invalidate_all();
+
+/**
+ * @brief Clears the hit and miss counters of all registered caches.
+ */
+void reply_cache_reset_counters();
+
+/**
+ * @brief Fetches the first registered cache, iterate further through `next`.
+ * @return a pointer to the first `reply_cache` or `NULL`.
+ */
+const reply_cache* reply_cache_first();
+
+/**
+ * @brief Frees the stored replies of all registered caches.
+ */
+void reply_cache_cleanup();
+
+#endif // REPLY_CACHE_H
@@ -0,0 +1,71 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include <time.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <libubox/uloop.h>
+
+#include "stats.h"
+
+/**
+ * @typedef sampler_hook
+ * @property {const char*} name - The name of the collector.
+ * @property {void (*)(void)} collect - Collector run on the collector thread on every tick, `NULL` if the hook only publishes.
+ * @property {void (*)(void)} cb - Invoked on the event loop once every collector of the tick ran, `NULL` if there is nothing to publish.
+ * @property {uint64_t} collect_ns - Run time of the last `collect`.
+ * @property {histogram} latency - Run time of `collect` and `cb` together.
+ * @property {sampler_hook*} next - Next registered hook.
+ * @note `collect` must only touch state the event loop does not read, `cb` publishes it
+ *       while the collector thread waits, so neither needs any locking.
+ */
+typedef struct sampler_hook {
+    const char* name;
+    void (*collect)(void);
+    void (*cb)(void);
+    uint64_t collect_ns;
+    histogram latency;
+    struct sampler_hook* next;
+} sampler_hook;
+
+/**
+ * @brief Runs every hook once and starts the collector thread.
+ * @param interval sampling interval in milliseconds.
+ * @return 0 on success, -1 on failure.
+ * @note if the thread cannot be started, the hooks are run on a uloop timer instead.
+ * @note hooks have to be registered before this call.
+ */
+int sampler_init(unsigned interval);
+
+/**
+ * @brief Registers a collector to be invoked on every sampler tick.
+ * @param hook pointer to a statically allocated `sampler_hook`.
+ * @note hooks run in registration order, first every `collect`, then every `cb`.
+ */
+void sampler_add(sampler_hook* hook);
+
+/**
+ * @brief Fetches the configured sampling interval.
+ * @return the interval in milliseconds.
+ */
+unsigned sampler_interval();
+
+/**
+ * @brief Fetches the first registered hook, iterate further through `next`.
+ * @return a pointer to the first `sampler_hook` or `NULL`.
+ */
+sampler_hook* sampler_first();
+
+/**
+ * @brief Stops the collector thread and the sampler and unregisters all hooks.
+ */
+void sampler_cleanup();
+
+#endif // SAMPLER_H
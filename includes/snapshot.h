@@ -0,0 +1,57 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <time.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <syslog.h>
+
+#include "defs.h"
+#include "arena.h"
+#include "stats.h"
+#include "helpers.h"
+#include "sampler.h"
+
+/* One snapshot is published, one may be read by the event loop and one is being collected */
+#define SNAPSHOT_BUFFERS    3
+
+/**
+ * @typedef snapshot
+ * @property {arena} mem - The arena every section of the snapshot is allocated from.
+ * @property {system_info} info - The collected CPU and memory sections.
+ * @property {uint64_t} taken - Monotonic timestamp of the collection in milliseconds.
+ * @note the network table and the users are owned by the event loop, they are left `NULL`.
+ */
+typedef struct snapshot {
+    arena mem;
+    system_info info;
+    uint64_t taken;
+} snapshot;
+
+/**
+ * @brief Parses the CPU identity and registers the snapshot collector with the sampler.
+ * @note the CPU section only holds static identity, it is parsed once into an arena of its own.
+ * @note the collector thread is the only reader of `/proc/meminfo`.
+ * @note has to be called before `sampler_init`.
+ */
+void snapshot_init();
+
+/**
+ * @brief Fetches the most recently published snapshot and keeps the collector from reusing it.
+ * @return a pointer to the snapshot.
+ * @note the snapshot has to be handed back through `snapshot_release` before the next call.
+ */
+const snapshot* snapshot_acquire();
+
+/**
+ * @brief Hands the acquired snapshot back to the collector.
+ */
+void snapshot_release();
+
+/**
+ * @brief Frees the arenas of all snapshots.
+ * @note the sampler has to be stopped first.
+ */
+void snapshot_cleanup();
+
+#endif // SNAPSHOT_H
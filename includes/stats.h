@@ -0,0 +1,140 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <time.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <stdbool.h>
+#include <sys/resource.h>
+#include <libubus.h>
+
+/* Every power of two is split into 2^STATS_SUB_BITS linear buckets, bounding the error to 25% */
+#define STATS_SUB_BITS      2
+#define STATS_SUB_BUCKETS   (1 << STATS_SUB_BITS)
+/* Enough buckets for latencies up to ~17 s, slower samples land in the last bucket */
+#define STATS_BUCKETS       132
+
+/**
+ * @brief Stages of a method call, time is attributed to the stage active when it passes.
+ */
+enum {
+    STATS_COLLECT,
+    STATS_SERIALISE,
+    STATS_SEND,
+    __STATS_STAGE_MAX
+};
+
+/**
+ * @typedef histogram
+ * @property {uint64_t} count - The number of recorded samples.
+ * @property {uint64_t} sum - The sum of all samples in nanoseconds.
+ * @property {uint64_t} max - The largest sample in nanoseconds.
+ * @property {uint32_t[STATS_BUCKETS]} buckets - Log-linear sample counts.
+ * @note samples are recorded with relaxed atomics, any thread may record without locking.
+ */
+typedef struct histogram {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    uint32_t buckets[STATS_BUCKETS];
+} histogram;
+
+/**
+ * @typedef method_stats
+ * @property {const char*} name - The name of the method.
+ * @property {ubus_handler_t} handler - The handler the call is forwarded to.
+ * @property {uint64_t} calls - The number of calls.
+ * @property {uint64_t} errors - The number of calls that failed or replied with an error.
+ * @property {histogram} total - Latency of the whole call.
+ * @property {histogram[__STATS_STAGE_MAX]} stages - Latency of every stage of the call.
+ */
+typedef struct method_stats {
+    const char* name;
+    ubus_handler_t handler;
+    uint64_t calls;
+    uint64_t errors;
+    histogram total;
+    histogram stages[__STATS_STAGE_MAX];
+} method_stats;
+
+/**
+ * @brief Fetches the current value of the monotonic clock.
+ * @return the monotonic time in nanoseconds.
+ */
+uint64_t stats_now_ns();
+
+/**
+ * @brief Records a sample.
+ * @param h pointer to the `histogram`.
+ * @param ns the sample in nanoseconds.
+ */
+void histogram_record(histogram* h, uint64_t ns);
+
+/**
+ * @brief Estimates a percentile of the recorded samples.
+ * @param h pointer to the `histogram`.
+ * @param p the percentile between 0 and 100.
+ * @return the upper bound of the bucket holding the percentile in nanoseconds, 0 if empty.
+ */
+uint64_t histogram_percentile(const histogram* h, double p);
+
+/**
+ * @brief Fetches the exclusive upper bound of a bucket.
+ * @param bucket the index of the bucket.
+ * @return the bound in nanoseconds.
+ */
+uint64_t histogram_bucket_bound(unsigned bucket);
+
+/**
+ * @brief Clears all samples of a histogram.
+ * @param h pointer to the `histogram`.
+ */
+void histogram_reset(histogram* h);
+
+/**
+ * @brief Builds a copy of a method table whose handlers are timed.
+ * @param methods the method table of an object.
+ * @param count the number of methods.
+ * @return a pointer to the timed method table or `NULL` on failure.
+ * @note the user is responsible for calling `stats_cleanup`.
+ */
+struct ubus_method* stats_wrap(const struct ubus_method* methods, unsigned count);
+
+/**
+ * @brief Switches the call in progress to another stage.
+ * @param stage one of the `STATS_*` stages.
+ * @note does nothing outside of a timed call.
+ */
+void stats_mark(int stage);
+
+/**
+ * @brief Counts the call in progress as an error even though its handler succeeds.
+ */
+void stats_error();
+
+/**
+ * @brief Fetches the statistics of the timed methods.
+ * @param count receives the number of methods.
+ * @return a pointer to the array of `method_stats`.
+ */
+const method_stats* stats_methods(unsigned* count);
+
+/**
+ * @brief Fetches the monotonic time of the last reset.
+ * @return the time in nanoseconds.
+ */
+uint64_t stats_since();
+
+/**
+ * @brief Clears the counters and histograms of every method.
+ */
+void stats_reset();
+
+/**
+ * @brief Frees the timed method table and its statistics.
+ */
+void stats_cleanup();
+
+#endif // STATS_H
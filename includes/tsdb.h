@@ -0,0 +1,145 @@
+#ifndef TSDB_H
+#define TSDB_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <stdbool.h>
+
+/* Size of the compressed payload of a block in bytes */
+#define TSDB_BLOCK_SIZE     1024
+/* Bits a single sample takes at most: the widest timestamp and value encodings */
+#define TSDB_SAMPLE_BITS    (4 + 64 + 2 + 5 + 5 + 32)
+
+/**
+ * @typedef tsdb_block
+ * @property {tsdb_block*} next - The next newer block.
+ * @property {uint64_t} min_ms - The earliest timestamp of the block.
+ * @property {uint64_t} max_ms - The latest timestamp of the block.
+ * @property {uint32_t} count - The number of samples in the block.
+ * @property {uint32_t} bits - The number of bits written to `data`.
+ * @property {uint8_t[TSDB_BLOCK_SIZE]} data - Delta-of-delta timestamps and XOR compressed values.
+ * @note a block decodes on its own, the first sample is stored raw.
+ */
+typedef struct tsdb_block {
+    struct tsdb_block* next;
+    uint64_t min_ms;
+    uint64_t max_ms;
+    uint32_t count;
+    uint32_t bits;
+    uint8_t data[TSDB_BLOCK_SIZE];
+} tsdb_block;
+
+/**
+ * @typedef tsdb_series
+ * @property {const char*} name - The name the series is queried by.
+ * @property {size_t} budget - The memory the blocks of the series may take in bytes.
+ * @property {unsigned} block_count - The number of blocks held.
+ * @property {uint64_t} samples - The number of samples held.
+ * @property {tsdb_block*} oldest - The block evicted first.
+ * @property {tsdb_block*} newest - The block samples are appended to.
+ * @property {uint64_t} last_ms - Timestamp of the last appended sample.
+ * @property {int64_t} last_delta - Difference between the last two timestamps of the newest block.
+ * @property {uint32_t} last_value - Bits of the last appended value.
+ * @property {uint8_t} leading - Leading zero bits of the last stored XOR.
+ * @property {uint8_t} trailing - Trailing zero bits of the last stored XOR.
+ * @property {tsdb_series*} next - Next registered series.
+ */
+typedef struct tsdb_series {
+    const char* name;
+    size_t budget;
+    unsigned block_count;
+    uint64_t samples;
+    tsdb_block* oldest;
+    tsdb_block* newest;
+    uint64_t last_ms;
+    int64_t last_delta;
+    uint32_t last_value;
+    uint8_t leading;
+    uint8_t trailing;
+    struct tsdb_series* next;
+} tsdb_series;
+
+/**
+ * @typedef tsdb_iter
+ * @property {const tsdb_block*} block - The block being decoded.
+ * @property {uint32_t} index - The samples of the block decoded so far.
+ * @property {uint32_t} pos - The bit position of the next sample in the block.
+ * @property {uint64_t} ms - Timestamp of the last decoded sample.
+ * @property {int64_t} delta - Difference between the last two decoded timestamps.
+ * @property {uint32_t} value - Bits of the last decoded value.
+ * @property {uint8_t} leading - Leading zero bits of the last decoded XOR.
+ * @property {uint8_t} trailing - Trailing zero bits of the last decoded XOR.
+ * @property {uint64_t} from - Samples before this timestamp are skipped.
+ * @property {uint64_t} to - Samples from this timestamp on are skipped.
+ */
+typedef struct tsdb_iter {
+    const tsdb_block* block;
+    uint32_t index;
+    uint32_t pos;
+    uint64_t ms;
+    int64_t delta;
+    uint32_t value;
+    uint8_t leading;
+    uint8_t trailing;
+    uint64_t from;
+    uint64_t to;
+} tsdb_iter;
+
+/**
+ * @brief Registers a series.
+ * @param series pointer to a statically allocated `tsdb_series` with `name` and `budget` set.
+ * @note the budget is rounded down to whole blocks, at least two are kept.
+ */
+void tsdb_add(tsdb_series* series);
+
+/**
+ * @brief Fetches the first registered series.
+ * @return a pointer to the first `tsdb_series` or `NULL`.
+ */
+tsdb_series* tsdb_first();
+
+/**
+ * @brief Looks up a series by name.
+ * @param name the name of the series.
+ * @return a pointer to the `tsdb_series` or `NULL`.
+ */
+tsdb_series* tsdb_find(const char* name);
+
+/**
+ * @brief Appends a sample, evicting the oldest block once the budget is used up.
+ * @param series pointer to the `tsdb_series`.
+ * @param time_ms timestamp of the sample in milliseconds.
+ * @param value the value, stored with single precision.
+ * @return 0 on success, -1 if no block could be allocated.
+ */
+int tsdb_append(tsdb_series* series, uint64_t time_ms, float value);
+
+/**
+ * @brief Prepares decoding the samples of a time range.
+ * @param it pointer to the `tsdb_iter` to initialise.
+ * @param series pointer to the `tsdb_series`.
+ * @param from_ms first timestamp of the range.
+ * @param to_ms timestamp following the range.
+ * @note blocks outside the range are skipped without being decoded.
+ * @note the iterator is invalidated by the next `tsdb_append` to the series.
+ */
+void tsdb_iter_init(tsdb_iter* it, const tsdb_series* series, uint64_t from_ms, uint64_t to_ms);
+
+/**
+ * @brief Decodes the next sample of the range.
+ * @param it pointer to the `tsdb_iter`.
+ * @param time_ms receives the timestamp of the sample.
+ * @param value receives the value of the sample.
+ * @return false once the range is exhausted.
+ */
+bool tsdb_iter_next(tsdb_iter* it, uint64_t* time_ms, float* value);
+
+/**
+ * @brief Frees the blocks of every series and unregisters them.
+ */
+void tsdb_cleanup();
+
+#endif // TSDB_H
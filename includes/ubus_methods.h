@@ -7,13 +7,128 @@
 
 #include "defs.h"
 #include "helpers.h"
+#include "sampler.h"
+#include "cpu_usage.h"
+#include "reply_cache.h"
+#include "netdev.h"
+#include "diskstats.h"
+#include "fsusage.h"
+#include "pressure.h"
+#include "cpustate.h"
+#include "history.h"
+#include "tsdb.h"
+#include "feeds.h"
+#include "stats.h"
+#include "snapshot.h"
+#include "procstat.h"
+#include "ptree.h"
 
 enum { PROC_ID, SIGNAL_ID, __PSIG_MAX };
+enum { SIGNAL_MANY_PIDS, SIGNAL_MANY_NAME, SIGNAL_MANY_SIG, __PSIG_MANY_MAX };
 enum { __PLOOKUP_MAX = 1 };
+enum { PROC_IDS, __PLOOKUP_MANY_MAX };
+enum { TOP_BY, TOP_COUNT, __TOP_MAX };
+enum { PTREE_PID, __PTREE_MAX };
+enum { CACHE_FLUSH, __CACHE_MAX };
+enum { SUBSCRIBE_GROUPS, SUBSCRIBE_INTERVAL, SUBSCRIBE_DELTA, __SUBSCRIBE_MAX };
+enum { STATS_RESET, STATS_HISTOGRAMS, __STATS_MAX };
+enum { MEM_FIELDS, __MEM_MAX };
+enum { INFO_SECTIONS, __INFO_MAX };
+enum { HISTORY_FROM, HISTORY_TO, HISTORY_COUNT, __HISTORY_MAX };
+enum { SERIES_NAME, SERIES_FROM, SERIES_TO, SERIES_COUNT, __SERIES_MAX };
 
+/* Metrics kept in memory as compressed series */
+enum {
+    METRIC_CPU_USAGE,
+    METRIC_MEM_USED,
+    METRIC_RX_BPS,
+    METRIC_TX_BPS,
+    METRIC_LOAD1,
+    METRIC_LOAD5,
+    METRIC_LOAD15,
+    METRIC_TASKS,
+    METRIC_CPU_PRESSURE,
+    METRIC_MEMORY_PRESSURE,
+    METRIC_IO_PRESSURE,
+    __METRIC_MAX
+};
+
+/**
+ * @typedef ubm_config
+ * @property {unsigned} sample_interval - Sampling interval of the background collectors in milliseconds.
+ * @property {unsigned} cache_ttl - Time to live of cached method replies in milliseconds.
+ * @property {const char*} socket - Path of the ubusd socket or `NULL` for the default one.
+ * @property {const char*} history - Path of the history file, empty to disable it.
+ * @property {unsigned} series_budget - Memory budget of every in-memory series in KiB.
+ */
+typedef struct ubm_config {
+    unsigned sample_interval;
+    unsigned cache_ttl;
+    const char* socket;
+    const char* history;
+    unsigned series_budget;
+} ubm_config;
+
+/**
+ * @typedef history_bucket
+ * @property {unsigned} samples - The number of records averaged into the bucket.
+ * @property {uint64_t} time_ms - Sum of the record times in milliseconds.
+ * @property {double} cpu_max - The highest CPU utilisation of the bucket.
+ * @property {double} cpu_usage - Sum of the CPU utilisation of the records.
+ * @property {double} mem_used - Sum of the memory in use.
+ * @property {double} rx_bps - Sum of the receive rates.
+ * @property {double} tx_bps - Sum of the transmit rates.
+ * @property {double} load1 - Sum of the 1 minute load averages.
+ * @property {double} load5 - Sum of the 5 minute load averages.
+ * @property {double} load15 - Sum of the 15 minute load averages.
+ * @property {double} tasks - Sum of the task counts.
+ * @note the sums are divided by `samples` when the bucket is sent.
+ */
+typedef struct history_bucket {
+    unsigned samples;
+    uint64_t time_ms;
+    double cpu_max;
+    double cpu_usage;
+    double mem_used;
+    double rx_bps;
+    double tx_bps;
+    double load1;
+    double load5;
+    double load15;
+    double tasks;
+} history_bucket;
+
+/**
+ * @typedef series_bucket
+ * @property {unsigned} samples - The number of samples folded into the bucket.
+ * @property {uint64_t} time_ms - Sum of the sample times in milliseconds.
+ * @property {double} sum - Sum of the values.
+ * @property {double} min - The lowest value.
+ * @property {double} max - The highest value.
+ */
+typedef struct series_bucket {
+    unsigned samples;
+    uint64_t time_ms;
+    double sum;
+    double min;
+    double max;
+} series_bucket;
+
+/**
+ * @typedef info_section
+ * @property {const char*} name - The name the section is requested by.
+ * @property {bool} snapshot - Whether the section is read from the collector snapshot.
+ * @property {void (*)(struct blob_buf*, const system_info*)} add - Collects and serialises the section into the buffer.
+ */
+typedef struct info_section {
+    const char* name;
+    bool snapshot;
+    void (*add)(struct blob_buf* buf, const system_info* info);
+} info_section;
+
+extern ubm_config config;
 extern struct blob_buf b;
 extern struct ubus_context* ctx;
-extern system_info* info;
 
 int initialize_ubus();
 void ubus_methods_cleanup();
@@ -34,12 +149,64 @@ int get_network(struct ubus_context *ctx, struct ubus_object *obj,
         struct ubus_request_data *req, const char *method,
         struct blob_attr *msg);
 
+int get_disk(struct ubus_context *ctx, struct ubus_object *obj,
+        struct ubus_request_data *req, const char *method,
+        struct blob_attr *msg);
+
+int get_fs(struct ubus_context *ctx, struct ubus_object *obj,
+        struct ubus_request_data *req, const char *method,
+        struct blob_attr *msg);
+
+int get_pressure_method(struct ubus_context *ctx, struct ubus_object *obj,
+        struct ubus_request_data *req, const char *method,
+        struct blob_attr *msg);
+
+int get_history(struct ubus_context *ctx, struct ubus_object *obj,
+        struct ubus_request_data *req, const char *method,
+        struct blob_attr *msg);
+
+int get_series(struct ubus_context *ctx, struct ubus_object *obj,
+        struct ubus_request_data *req, const char *method,
+        struct blob_attr *msg);
+
+int get_cpu_usage_method(struct ubus_context *ctx, struct ubus_object *obj,
+        struct ubus_request_data *req, const char *method,
+        struct blob_attr *msg);
+
 int ub_send_signal(struct ubus_context *ctx, struct ubus_object *obj,
         struct ubus_request_data *req, const char *method,
         struct blob_attr *msg);
 
+int ub_send_signal_many(struct ubus_context *ctx, struct ubus_object *obj,
+        struct ubus_request_data *req, const char *method,
+        struct blob_attr *msg);
+
 int ub_pid_lookup(struct ubus_context *ctx, struct ubus_object *obj,
         struct ubus_request_data *req, const char *method,
         struct blob_attr *msg);
 
+int ub_pid_lookup_many(struct ubus_context *ctx, struct ubus_object *obj,
+        struct ubus_request_data *req, const char *method,
+        struct blob_attr *msg);
+
+int ub_top(struct ubus_context *ctx, struct ubus_object *obj,
+        struct ubus_request_data *req, const char *method,
+        struct blob_attr *msg);
+
+int ub_ptree(struct ubus_context *ctx, struct ubus_object *obj,
+        struct ubus_request_data *req, const char *method,
+        struct blob_attr *msg);
+
+int get_cache_stats(struct ubus_context *ctx, struct ubus_object *obj,
+        struct ubus_request_data *req, const char *method,
+        struct blob_attr *msg);
+
+int ub_subscribe(struct ubus_context *ctx, struct ubus_object *obj,
+        struct ubus_request_data *req, const char *method,
+        struct blob_attr *msg);
+
+int get_stats(struct ubus_context *ctx, struct ubus_object *obj,
+        struct ubus_request_data *req, const char *method,
+        struct blob_attr *msg);
+
 #endif // UBUS_METHODS_H
\ No newline at end of file
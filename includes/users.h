@@ -0,0 +1,50 @@
+#ifndef USERS_H
+#define USERS_H
+
+#include <stdio.h>
+#include <fcntl.h>
+#include <paths.h>
+#include <utmp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syslog.h>
+#include <unistd.h>
+#include <stdbool.h>
+#include <sys/inotify.h>
+#include <libubox/uloop.h>
+
+/* Length of a user name, including the terminating NUL */
+#define USER_NAME_LEN       (UT_NAMESIZE + 1)
+
+/**
+ * @typedef user_list
+ * @property {unsigned} count - The number of logged in users.
+ * @property {unsigned} capacity - The number of names the array can hold.
+ * @property {char[USER_NAME_LEN]*} names - Sorted, unique names of the logged in users.
+ */
+typedef struct user_list {
+    unsigned count;
+    unsigned capacity;
+    char (*names)[USER_NAME_LEN];
+} user_list;
+
+/**
+ * @brief Starts watching the utmp file for changes through inotify.
+ * @return 0 on success, -1 if the file has to be reread on every request.
+ * @note requires `uloop_init` to have been called.
+ */
+int users_init();
+
+/**
+ * @brief Fetches the users currently logged in.
+ * @return a pointer to the cached `user_list`, reread only if utmp changed.
+ * @note the list is owned by the cache and stays valid until the next call.
+ */
+const user_list* get_current_users();
+
+/**
+ * @brief Stops watching utmp and frees the cached user list.
+ */
+void users_cleanup();
+
+#endif // USERS_H
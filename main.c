@@ -1,11 +1,37 @@
 #include <signal.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 #include "includes/ubus_methods.h"
 
 void handle_sig(int signo);
+void usage(const char* name);
+
+int main(int argc, char** argv) {
+    int opt;
+    while ((opt = getopt(argc, argv, "i:t:s:H:m:h")) != -1) {
+        switch (opt) {
+            case 'i':
+                config.sample_interval = (unsigned)strtoul(optarg, NULL, 10);
+                break;
+            case 't':
+                config.cache_ttl = (unsigned)strtoul(optarg, NULL, 10);
+                break;
+            case 's':
+                config.socket = optarg;
+                break;
+            case 'H':
+                config.history = optarg;
+                break;
+            case 'm':
+                config.series_budget = (unsigned)strtoul(optarg, NULL, 10);
+                break;
+            default:
+                usage(argv[0]);
+                return opt == 'h' ? 0 : 1;
+        }
+    }
 
-int main(void) {
     struct sigaction sa;
     sigset_t sigset;
     sigemptyset(&sigset);
@@ -32,6 +58,17 @@ int main(void) {
     return 0;
 }
 
+void usage(const char* name) {
+    fprintf(stderr, "Usage: %s [options]\n"
+        "  -i <ms>    sampling interval of the background collectors (default %d)\n"
+        "  -t <ms>    time to live of cached replies, 0 disables the cache (default %d)\n"
+        "  -s <path>  path of the ubusd socket\n"
+        "  -H <path>  file the sample history is kept in, empty to disable it (default %s)\n"
+        "  -m <KiB>   memory budget of every in-memory series (default %d)\n"
+        "  -h         show this help\n",
+        name, SAMPLER_INTERVAL, REPLY_CACHE_TTL, HISTORY_PATH, SERIES_BUDGET);
+}
+
 void handle_sig(int signo) {
     ubus_methods_cleanup();
     exit(0);
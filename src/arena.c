@@ -0,0 +1,73 @@
+#include "../includes/arena.h"
+
+#define ARENA_ROUND(n)      (((n) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+#define ARENA_HEADER        ARENA_ROUND(sizeof(arena_block))
+
+static arena_block* arena_block_new(size_t size) {
+    arena_block* block = (arena_block*) malloc(ARENA_HEADER + size);
+    if (block == NULL)
+        return NULL;
+
+    block->next = NULL;
+    block->size = size;
+    block->used = 0;
+    return block;
+}
+
+void* arena_alloc(arena* a, size_t size) {
+    size = ARENA_ROUND(size ? size : 1);
+
+    arena_block* block = a->blocks;
+    if (block == NULL || block->size - block->used < size) {
+        /* doubling keeps the number of blocks logarithmic until the first reset merges them */
+        size_t grow = a->size > ARENA_BLOCK_SIZE ? a->size : ARENA_BLOCK_SIZE;
+        if (grow < size)
+            grow = size;
+
+        block = arena_block_new(grow);
+        if (block == NULL)
+            return NULL;
+        block->next = a->blocks;
+        a->blocks = block;
+        a->size += grow;
+    }
+
+    void* p = (char*)block + ARENA_HEADER + block->used;
+    block->used += size;
+    a->used += size;
+    return p;
+}
+
+void* arena_calloc(arena* a, size_t n, size_t size) {
+    void* p = arena_alloc(a, n * size);
+    if (p != NULL)
+        memset(p, 0, n * size);
+    return p;
+}
+
+void arena_reset(arena* a) {
+    if (a->used > a->peak)
+        a->peak = a->used;
+    a->used = 0;
+
+    if (a->blocks != NULL && a->blocks->next != NULL) {
+        size_t size = a->size;
+        arena_free(a);
+        a->blocks = arena_block_new(size);
+        a->size = a->blocks != NULL ? size : 0;
+    } else if (a->blocks != NULL) {
+        a->blocks->used = 0;
+    }
+}
+
+void arena_free(arena* a) {
+    arena_block* block = a->blocks;
+    while (block != NULL) {
+        arena_block* next = block->next;
+        free(block);
+        block = next;
+    }
+    a->blocks = NULL;
+    a->size = 0;
+    a->used = 0;
+}
@@ -0,0 +1,146 @@
+#include "../includes/cpu_usage.h"
+#include "../includes/helpers.h"
+
+/* the collector fills the table the event loop is not reading, publishing swaps them */
+static cpu_usage usage[2];
+static unsigned capacity[2];
+static int current = 0;
+
+/* only touched by the collector */
+static cpu_times prev_total;
+static cpu_times* prev_cores = NULL;
+static unsigned prev_capacity = 0;
+static bool primed = false;
+
+/* Parses the jiffy columns of a "cpu" or "cpuN" line of /proc/stat */
+static void cpu_times_parse(const char* p, cpu_times* t) {
+    uint64_t user = procfs_scan_u64(&p);
+    uint64_t nice = procfs_scan_u64(&p);
+    t->system = procfs_scan_u64(&p);
+    t->idle = procfs_scan_u64(&p);
+    t->iowait = procfs_scan_u64(&p);
+    uint64_t irq = procfs_scan_u64(&p);
+    uint64_t softirq = procfs_scan_u64(&p);
+    t->steal = procfs_scan_u64(&p);
+    t->user = user + nice;
+    t->irq = irq + softirq;
+}
+
+/* Per-CPU counters are not guaranteed to be monotonic, e.g. iowait */
+static uint64_t delta(uint64_t cur, uint64_t prev) {
+    return cur > prev ? cur - prev : 0;
+}
+
+static void cpu_load_compute(cpu_load* load, const cpu_times* prev, const cpu_times* cur) {
+    uint64_t user = delta(cur->user, prev->user);
+    uint64_t system = delta(cur->system, prev->system);
+    uint64_t idle = delta(cur->idle, prev->idle);
+    uint64_t iowait = delta(cur->iowait, prev->iowait);
+    uint64_t irq = delta(cur->irq, prev->irq);
+    uint64_t steal = delta(cur->steal, prev->steal);
+    uint64_t total = user + system + idle + iowait + irq + steal;
+
+    unsigned id = load->id;
+    memset(load, 0, sizeof(cpu_load));
+    load->id = id;
+    if (total == 0)
+        return;
+
+    load->user = 100.0 * user / total;
+    load->system = 100.0 * system / total;
+    load->idle = 100.0 * idle / total;
+    load->iowait = 100.0 * iowait / total;
+    load->irq = 100.0 * irq / total;
+    load->steal = 100.0 * steal / total;
+    load->usage = 100.0 * (total - idle - iowait) / total;
+}
+
+static bool cpu_usage_reserve(int slot, unsigned count) {
+    if (count > capacity[slot]) {
+        cpu_load* cores = (cpu_load*) realloc(usage[slot].cores, count * sizeof(cpu_load));
+        if (cores == NULL)
+            return false;
+        usage[slot].cores = cores;
+        capacity[slot] = count;
+    }
+
+    if (count > prev_capacity) {
+        cpu_times* times = (cpu_times*) realloc(prev_cores, count * sizeof(cpu_times));
+        if (times == NULL)
+            return false;
+        prev_cores = times;
+        prev_capacity = count;
+    }
+    return true;
+}
+
+static void cpu_usage_collect() {
+    const char* data = procfs_read(PROCFS_STAT, NULL);
+    if (data == NULL)
+        return;
+
+    const cpu_usage* prev = &usage[current];
+    cpu_usage* next = &usage[!current];
+    unsigned index = 0;
+    for (const char* line = data; strncmp(line, "cpu", 3) == 0; line = procfs_next_line(line)) {
+        cpu_times cur;
+        const char* p = line + 3;
+        if (*p == ' ') {
+            cpu_times_parse(p, &cur);
+            if (primed)
+                cpu_load_compute(&next->total, &prev_total, &cur);
+            prev_total = cur;
+            continue;
+        }
+
+        unsigned id = (unsigned)procfs_scan_u64(&p);
+        if (!cpu_usage_reserve(!current, index + 1)) {
+            syslog(LOG_ERR, "Failed to allocate memory for per-CPU utilisation!");
+            break;
+        }
+
+        cpu_times_parse(p, &cur);
+        next->cores[index].id = id;
+        /* a CPU went on- or offline, this slot has no usable previous sample */
+        if (!primed || index >= prev->core_count || prev->cores[index].id != id) {
+            memset(&next->cores[index], 0, sizeof(cpu_load));
+            next->cores[index].id = id;
+        } else {
+            cpu_load_compute(&next->cores[index], &prev_cores[index], &cur);
+        }
+        prev_cores[index] = cur;
+        index++;
+    }
+
+    next->core_count = index;
+    next->valid = primed;
+    next->sampled = get_timestamp();
+    primed = true;
+}
+
+static void cpu_usage_publish() {
+    current = !current;
+}
+
+static sampler_hook cpu_usage_hook = { .name = "cpu_usage", .collect = cpu_usage_collect, .cb = cpu_usage_publish };
+
+void cpu_usage_init() {
+    sampler_add(&cpu_usage_hook);
+}
+
+const cpu_usage* get_cpu_usage() {
+    return &usage[current];
+}
+
+void cpu_usage_cleanup() {
+    for (int i = 0; i < 2; i++) {
+        free(usage[i].cores);
+        memset(&usage[i], 0, sizeof(cpu_usage));
+        capacity[i] = 0;
+    }
+    free(prev_cores);
+    prev_cores = NULL;
+    prev_capacity = 0;
+    current = 0;
+    primed = false;
+}
@@ -0,0 +1,230 @@
+#include "../includes/cpustate.h"
+#include "../includes/helpers.h"
+
+/* room for the sysfs root, one directory entry and the longest attribute path below it */
+#define CPUSTATE_PATH_LEN   (PATH_MAX + NAME_MAX + 64)
+
+static cpu_state state = { 0 };
+static unsigned core_capacity = 0;
+static unsigned zone_capacity = 0;
+
+/* the collector reads into these, publishing copies them into the state, cores first */
+typedef struct sysfs_reading {
+    bool valid;
+    int64_t value;
+} sysfs_reading;
+
+static sysfs_reading* readings = NULL;
+static char sysfs[PATH_MAX] = "/sys";
+
+/* sysfs attributes hold a single value and are regenerated on every read from offset 0 */
+static bool sysfs_read(int fd, char* buf, size_t size) {
+    ssize_t n = pread(fd, buf, size - 1, 0);
+    if (n <= 0)
+        return false;
+    buf[n] = '\0';
+    return true;
+}
+
+static bool sysfs_read_path(const char* path, char* buf, size_t size) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+    bool ok = sysfs_read(fd, buf, size);
+    close(fd);
+    return ok;
+}
+
+static uint64_t sysfs_read_u64(const char* path) {
+    char buf[32];
+    return sysfs_read_path(path, buf, sizeof(buf)) ? strtoull(buf, NULL, 10) : 0;
+}
+
+/* Matches "<prefix><number>" and extracts the number */
+static bool sysfs_numbered(const char* name, const char* prefix, unsigned* number) {
+    size_t len = strlen(prefix);
+    if (strncmp(name, prefix, len) != 0 || name[len] < '0' || name[len] > '9')
+        return false;
+
+    char* end;
+    *number = (unsigned) strtoul(name + len, &end, 10);
+    return *end == '\0';
+}
+
+static void* grow(void* array, unsigned* capacity, size_t size) {
+    unsigned grown = *capacity ? *capacity * 2 : 8;
+    void* p = realloc(array, grown * size);
+    if (p != NULL)
+        *capacity = grown;
+    return p;
+}
+
+static int cpustate_open_cores() {
+    char path[CPUSTATE_PATH_LEN];
+    snprintf(path, sizeof(path), "%s/devices/system/cpu", sysfs);
+    DIR* dir = opendir(path);
+    if (dir == NULL)
+        return 0;
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        unsigned cpu;
+        if (!sysfs_numbered(entry->d_name, "cpu", &cpu))
+            continue;
+
+        snprintf(path, sizeof(path), "%s/devices/system/cpu/%s/cpufreq/scaling_cur_freq", sysfs, entry->d_name);
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            continue;
+
+        if (state.core_count == core_capacity) {
+            core_freq* cores = (core_freq*) grow(state.cores, &core_capacity, sizeof(core_freq));
+            if (cores == NULL) {
+                syslog(LOG_ERR, "Failed to allocate memory for the core frequencies!");
+                close(fd);
+                closedir(dir);
+                return -1;
+            }
+            state.cores = cores;
+        }
+
+        core_freq* core = &state.cores[state.core_count++];
+        memset(core, 0, sizeof(core_freq));
+        core->cpu = cpu;
+        core->fd = fd;
+        snprintf(path, sizeof(path), "%s/devices/system/cpu/%s/cpufreq/cpuinfo_min_freq", sysfs, entry->d_name);
+        core->min_khz = sysfs_read_u64(path);
+        snprintf(path, sizeof(path), "%s/devices/system/cpu/%s/cpufreq/cpuinfo_max_freq", sysfs, entry->d_name);
+        core->max_khz = sysfs_read_u64(path);
+    }
+    closedir(dir);
+    return 0;
+}
+
+static int cpustate_open_zones() {
+    char path[CPUSTATE_PATH_LEN];
+    snprintf(path, sizeof(path), "%s/class/thermal", sysfs);
+    DIR* dir = opendir(path);
+    if (dir == NULL)
+        return 0;
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        unsigned number;
+        if (!sysfs_numbered(entry->d_name, "thermal_zone", &number))
+            continue;
+
+        snprintf(path, sizeof(path), "%s/class/thermal/%s/temp", sysfs, entry->d_name);
+        int fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            continue;
+
+        if (state.zone_count == zone_capacity) {
+            thermal_zone* zones = (thermal_zone*) grow(state.zones, &zone_capacity, sizeof(thermal_zone));
+            if (zones == NULL) {
+                syslog(LOG_ERR, "Failed to allocate memory for the thermal zones!");
+                close(fd);
+                closedir(dir);
+                return -1;
+            }
+            state.zones = zones;
+        }
+
+        thermal_zone* zone = &state.zones[state.zone_count++];
+        memset(zone, 0, sizeof(thermal_zone));
+        zone->zone = number;
+        zone->fd = fd;
+        snprintf(path, sizeof(path), "%s/class/thermal/%s/type", sysfs, entry->d_name);
+        if (sysfs_read_path(path, zone->type, sizeof(zone->type)))
+            zone->type[strcspn(zone->type, "\n")] = '\0';
+    }
+    closedir(dir);
+    return 0;
+}
+
+static int core_cmp(const void* a, const void* b) {
+    unsigned x = ((const core_freq*)a)->cpu, y = ((const core_freq*)b)->cpu;
+    return x < y ? -1 : x > y;
+}
+
+static int zone_cmp(const void* a, const void* b) {
+    unsigned x = ((const thermal_zone*)a)->zone, y = ((const thermal_zone*)b)->zone;
+    return x < y ? -1 : x > y;
+}
+
+static void cpustate_collect() {
+    char buf[32];
+    for (unsigned i = 0; i < state.core_count; i++) {
+        sysfs_reading* r = &readings[i];
+        r->valid = sysfs_read(state.cores[i].fd, buf, sizeof(buf));
+        if (r->valid)
+            r->value = (int64_t)strtoull(buf, NULL, 10);
+    }
+    for (unsigned i = 0; i < state.zone_count; i++) {
+        sysfs_reading* r = &readings[state.core_count + i];
+        /* sensors that are powered down fail the read until they come back */
+        r->valid = sysfs_read(state.zones[i].fd, buf, sizeof(buf));
+        if (r->valid)
+            r->value = strtoll(buf, NULL, 10);
+    }
+}
+
+static void cpustate_publish() {
+    for (unsigned i = 0; i < state.core_count; i++) {
+        state.cores[i].valid = readings[i].valid;
+        if (readings[i].valid)
+            state.cores[i].cur_khz = (uint64_t)readings[i].value;
+    }
+    for (unsigned i = 0; i < state.zone_count; i++) {
+        const sysfs_reading* r = &readings[state.core_count + i];
+        state.zones[i].valid = r->valid;
+        if (r->valid)
+            state.zones[i].temp_mc = r->value;
+    }
+    state.sampled = get_timestamp();
+}
+
+static sampler_hook cpustate_hook = { .name = "cpustate", .collect = cpustate_collect, .cb = cpustate_publish };
+
+int cpustate_init(const char* path) {
+    if (path != NULL)
+        snprintf(sysfs, sizeof(sysfs), "%s", path);
+
+    if (cpustate_open_cores() != 0 || cpustate_open_zones() != 0) {
+        cpustate_cleanup();
+        return -1;
+    }
+
+    qsort(state.cores, state.core_count, sizeof(core_freq), core_cmp);
+    qsort(state.zones, state.zone_count, sizeof(thermal_zone), zone_cmp);
+    if (state.core_count == 0)
+        syslog(LOG_INFO, "No cpufreq policies found, core frequencies will not be reported");
+
+    /* one spare entry, calloc may return NULL for systems without cores and zones */
+    readings = (sysfs_reading*) calloc(state.core_count + state.zone_count + 1, sizeof(sysfs_reading));
+    if (readings == NULL) {
+        syslog(LOG_ERR, "Failed to allocate memory for the sysfs readings!");
+        cpustate_cleanup();
+        return -1;
+    }
+    sampler_add(&cpustate_hook);
+    return 0;
+}
+
+const cpu_state* get_cpu_state() {
+    return &state;
+}
+
+void cpustate_cleanup() {
+    for (unsigned i = 0; i < state.core_count; i++)
+        close(state.cores[i].fd);
+    for (unsigned i = 0; i < state.zone_count; i++)
+        close(state.zones[i].fd);
+
+    free(state.cores);
+    free(state.zones);
+    free(readings);
+    readings = NULL;
+    memset(&state, 0, sizeof(state));
+    core_capacity = zone_capacity = 0;
+}
@@ -0,0 +1,229 @@
+#include "../includes/diskstats.h"
+#include "../includes/helpers.h"
+
+/* two tables alternate so rates can be derived from the previous sample */
+static disk_table tables[2];
+static unsigned capacity[2];
+static uint64_t sampled_at[2];
+static int current = -1;
+/* whether the collector filled the other table since the last publish */
+static bool collected = false;
+
+/* whether a device is reported is decided once per name, diskstats lists partitions too */
+typedef struct disk_class {
+    char name[DISK_NAME_LEN];
+    bool physical;
+} disk_class;
+
+static disk_class* classes = NULL;
+static unsigned class_count = 0;
+static unsigned class_capacity = 0;
+static bool sysfs_available = false;
+
+/* Whole devices have an entry in /sys/block, the ones under /sys/devices/virtual are not backed by hardware */
+static bool disk_physical(const char* name) {
+    if (!sysfs_available)
+        return true;
+
+    char path[sizeof(DISK_SYSFS_BLOCK) + DISK_NAME_LEN + 1];
+    snprintf(path, sizeof(path), "%s/%s", DISK_SYSFS_BLOCK, name);
+    /* sysfs spells the '/' of names like cciss/c0d0 as '!' */
+    for (char* p = path + sizeof(DISK_SYSFS_BLOCK); *p != '\0'; p++) {
+        if (*p == '/')
+            *p = '!';
+    }
+
+    char target[PATH_MAX];
+    ssize_t n = readlink(path, target, sizeof(target) - 1);
+    if (n < 0)
+        return false;
+    target[n] = '\0';
+    return strstr(target, "/virtual/") == NULL;
+}
+
+static bool disk_classify(const char* name, unsigned hint) {
+    /* devices are listed in the same order every time */
+    if (hint < class_count && strcmp(classes[hint].name, name) == 0)
+        return classes[hint].physical;
+    for (unsigned i = 0; i < class_count; i++) {
+        if (strcmp(classes[i].name, name) == 0)
+            return classes[i].physical;
+    }
+
+    bool physical = disk_physical(name);
+    if (class_count == class_capacity) {
+        unsigned grown = class_capacity ? class_capacity * 2 : 16;
+        disk_class* grown_classes = (disk_class*) realloc(classes, grown * sizeof(disk_class));
+        if (grown_classes == NULL)
+            return physical;
+        classes = grown_classes;
+        class_capacity = grown;
+    }
+    snprintf(classes[class_count].name, DISK_NAME_LEN, "%s", name);
+    classes[class_count].physical = physical;
+    class_count++;
+    return physical;
+}
+
+static disk_info* disk_append(int slot) {
+    disk_table* t = &tables[slot];
+    if (t->disk_count == capacity[slot]) {
+        unsigned grown = capacity[slot] ? capacity[slot] * 2 : 8;
+        disk_info* disks = (disk_info*) realloc(t->disks, grown * sizeof(disk_info));
+        if (disks == NULL) {
+            syslog(LOG_ERR, "Failed to allocate memory for the block device table!");
+            return NULL;
+        }
+        t->disks = disks;
+        capacity[slot] = grown;
+    }
+
+    disk_info* disk = &t->disks[t->disk_count++];
+    memset(disk, 0, sizeof(disk_info));
+    return disk;
+}
+
+static int disk_read_proc(int slot) {
+    const char* data = procfs_read(PROCFS_DISKSTATS, NULL);
+    if (data == NULL)
+        return -1;
+
+    unsigned index = 0;
+    for (const char* line = data; *line != '\0'; line = procfs_next_line(line), index++) {
+        /* a line without newline is not a complete entry */
+        if (strchr(line, '\n') == NULL)
+            break;
+
+        /* major and minor number precede the name */
+        const char* p = line;
+        procfs_scan_u64(&p);
+        procfs_scan_u64(&p);
+        while (*p == ' ')
+            p++;
+
+        const char* end = p;
+        while (*end != ' ' && *end != '\n' && *end != '\0')
+            end++;
+
+        char name[DISK_NAME_LEN];
+        size_t name_len = end - p;
+        if (name_len == 0)
+            continue;
+        if (name_len >= sizeof(name))
+            name_len = sizeof(name) - 1;
+        memcpy(name, p, name_len);
+        name[name_len] = '\0';
+        if (!disk_classify(name, index))
+            continue;
+
+        disk_info* disk = disk_append(slot);
+        if (disk == NULL)
+            return -1;
+
+        memcpy(disk->name, name, name_len + 1);
+        p = end;
+        disk->reads = procfs_scan_u64(&p);
+        disk->reads_merged = procfs_scan_u64(&p);
+        disk->sectors_read = procfs_scan_u64(&p);
+        disk->read_ms = procfs_scan_u64(&p);
+        disk->writes = procfs_scan_u64(&p);
+        disk->writes_merged = procfs_scan_u64(&p);
+        disk->sectors_written = procfs_scan_u64(&p);
+        disk->write_ms = procfs_scan_u64(&p);
+        disk->in_flight = procfs_scan_u64(&p);
+        disk->io_ms = procfs_scan_u64(&p);
+        disk->weighted_io_ms = procfs_scan_u64(&p);
+    }
+    return 0;
+}
+
+static const disk_info* disk_find(const disk_table* t, const disk_info* disk, unsigned hint) {
+    if (hint < t->disk_count && strcmp(t->disks[hint].name, disk->name) == 0)
+        return &t->disks[hint];
+    for (unsigned i = 0; i < t->disk_count; i++) {
+        if (strcmp(t->disks[i].name, disk->name) == 0)
+            return &t->disks[i];
+    }
+    return NULL;
+}
+
+/* Counters wrap at 32 bits on some architectures, a wrapped counter yields no rate for one sample */
+static double disk_rate(uint64_t cur, uint64_t prev, uint64_t elapsed, double scale) {
+    if (cur < prev || elapsed == 0)
+        return 0.0;
+    return (double)(cur - prev) * scale * 1000.0 / (double)elapsed;
+}
+
+/* Fills the table the event loop is not reading, the classification cache is the collector's own */
+static void diskstats_collect() {
+    int next = current == 0 ? 1 : 0;
+    collected = false;
+    tables[next].disk_count = 0;
+    if (disk_read_proc(next) != 0) {
+        syslog(LOG_WARNING, "Failed to sample the block devices");
+        return;
+    }
+
+    uint64_t now = get_monotonic_ms();
+    sampled_at[next] = now;
+    tables[next].sampled = get_timestamp();
+    tables[next].rates = current >= 0;
+    collected = true;
+    if (current < 0)
+        return;
+
+    uint64_t elapsed = now - sampled_at[current];
+    for (unsigned i = 0; i < tables[next].disk_count; i++) {
+        disk_info* disk = &tables[next].disks[i];
+        const disk_info* prev = disk_find(&tables[current], disk, i);
+        if (prev == NULL)
+            continue;
+
+        disk->read_iops = disk_rate(disk->reads, prev->reads, elapsed, 1.0);
+        disk->write_iops = disk_rate(disk->writes, prev->writes, elapsed, 1.0);
+        disk->read_bps = disk_rate(disk->sectors_read, prev->sectors_read, elapsed, DISK_SECTOR_SIZE);
+        disk->write_bps = disk_rate(disk->sectors_written, prev->sectors_written, elapsed, DISK_SECTOR_SIZE);
+        /* io_ms is in milliseconds already, its rate per second is a fraction of 1000 */
+        disk->busy = disk_rate(disk->io_ms, prev->io_ms, elapsed, 0.1);
+        if (disk->busy > 100.0)
+            disk->busy = 100.0;
+    }
+}
+
+static void diskstats_publish() {
+    if (collected)
+        current = current == 0 ? 1 : 0;
+    collected = false;
+}
+
+void diskstats_sample() {
+    diskstats_collect();
+    diskstats_publish();
+}
+
+static sampler_hook diskstats_hook = { .name = "diskstats", .collect = diskstats_collect, .cb = diskstats_publish };
+
+void diskstats_init() {
+    /* sysfs only describes the devices of the live system, not those of another procfs root */
+    sysfs_available = strcmp(procfs_root(), "/proc") == 0 && access(DISK_SYSFS_BLOCK, F_OK) == 0;
+    if (!sysfs_available)
+        syslog(LOG_WARNING, "%s is not available, reporting every block device", DISK_SYSFS_BLOCK);
+    sampler_add(&diskstats_hook);
+}
+
+const disk_table* get_disk_table() {
+    return current < 0 ? NULL : &tables[current];
+}
+
+void diskstats_cleanup() {
+    for (int i = 0; i < 2; i++) {
+        free(tables[i].disks);
+        memset(&tables[i], 0, sizeof(disk_table));
+        capacity[i] = 0;
+    }
+    current = -1;
+    collected = false;
+    free(classes);
+    classes = NULL;
+    class_count = class_capacity = 0;
+}
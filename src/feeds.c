@@ -0,0 +1,184 @@
+#include "../includes/feeds.h"
+#include "../includes/helpers.h"
+
+static struct ubus_context* feeds_ctx = NULL;
+static const feed_group* feed_groups = NULL;
+static unsigned feed_group_total = 0;
+static feed* feeds = NULL;
+static unsigned feed_count = 0;
+static unsigned feed_next_id = 0;
+
+/* One serialised message per group, shared by every feed published in the same round */
+static struct blob_buf group_bufs[FEED_MAX_GROUPS];
+
+/* Feeds have no methods, they only carry notifications */
+static struct ubus_object_type feed_type = { .name = "ubm.feed" };
+
+static void feed_subscribe_cb(struct ubus_context* ctx, struct ubus_object* obj) {
+    feed* f = container_of(obj, feed, obj);
+    if (obj->has_subscribers)
+        f->subscribed = true;
+}
+
+static void feed_remove(feed* f) {
+    ubus_remove_object(feeds_ctx, &f->obj);
+    feed_count--;
+    free(f);
+}
+
+static bool feed_expired(const feed* f, uint64_t now) {
+    if (f->subscribed)
+        return !f->obj.has_subscribers;
+    return now - f->created >= FEED_GRACE;
+}
+
+static bool feed_changed(const feed* f, unsigned group, double value) {
+    if (!(f->sent & (1u << group)))
+        return true;
+
+    double diff = value - f->last[group];
+    if (diff < 0)
+        diff = -diff;
+    if (diff == 0)
+        return false;
+
+    double threshold = f->delta;
+    if (feed_groups[group].relative) {
+        double base = f->last[group] < 0 ? -f->last[group] : f->last[group];
+        threshold = base * f->delta / 100.0;
+    }
+    return diff >= threshold;
+}
+
+/* Runs after the collectors, every group is serialised at most once per round */
+static void feeds_publish() {
+    uint64_t now = get_monotonic_ms();
+    unsigned slack = sampler_interval() / 2;
+    unsigned collected = 0, failed = 0;
+    double values[FEED_MAX_GROUPS];
+
+    feed** link = &feeds;
+    while (*link != NULL) {
+        feed* f = *link;
+        if (feed_expired(f, now)) {
+            *link = f->next;
+            feed_remove(f);
+            continue;
+        }
+        link = &f->next;
+
+        if (!f->obj.has_subscribers)
+            continue;
+        if (f->published != 0 && now + slack < f->published + f->interval)
+            continue;
+        f->published = now;
+
+        for (unsigned g = 0; g < feed_group_total; g++) {
+            unsigned bit = 1u << g;
+            if (!(f->groups & bit))
+                continue;
+
+            if (!(collected & bit)) {
+                collected |= bit;
+                blob_buf_init(&group_bufs[g], 0);
+                if (feed_groups[g].collect(&group_bufs[g], &values[g]))
+                    blobmsg_add_u32(&group_bufs[g], "requested", get_timestamp());
+                else
+                    failed |= bit;
+            }
+            if ((failed & bit) || !feed_changed(f, g, values[g]))
+                continue;
+
+            f->last[g] = values[g];
+            f->sent |= bit;
+            ubus_notify(feeds_ctx, &f->obj, feed_groups[g].name, group_bufs[g].head, -1);
+        }
+    }
+}
+
+static sampler_hook feeds_hook = { .name = "feeds", .cb = feeds_publish };
+
+int feeds_init(struct ubus_context* ctx, const feed_group* groups, unsigned count) {
+    if (count > FEED_MAX_GROUPS) {
+        syslog(LOG_ERR, "Too many feed groups, at most %d are supported!", FEED_MAX_GROUPS);
+        return -1;
+    }
+
+    feeds_ctx = ctx;
+    feed_groups = groups;
+    feed_group_total = count;
+    sampler_add(&feeds_hook);
+    return 0;
+}
+
+int feeds_group_index(const char* name) {
+    for (unsigned i = 0; i < feed_group_total; i++) {
+        if (strcmp(feed_groups[i].name, name) == 0)
+            return i;
+    }
+    return -1;
+}
+
+const char* feeds_group_name(unsigned index) {
+    return feed_groups[index].name;
+}
+
+unsigned feeds_group_count() {
+    return feed_group_total;
+}
+
+const feed* feeds_subscribe(unsigned groups, unsigned interval, unsigned delta) {
+    if (interval < sampler_interval())
+        interval = sampler_interval();
+
+    for (feed* f = feeds; f != NULL; f = f->next) {
+        if (f->groups == groups && f->interval == interval && f->delta == delta)
+            return f;
+    }
+
+    if (feed_count >= FEED_MAX_FEEDS) {
+        syslog(LOG_WARNING, "Refusing to create more than %d feeds!", FEED_MAX_FEEDS);
+        return NULL;
+    }
+
+    feed* f = (feed*) calloc(1, sizeof(feed));
+    if (f == NULL) {
+        syslog(LOG_ERR, "Failed to allocate memory for a feed!");
+        return NULL;
+    }
+
+    snprintf(f->name, sizeof(f->name), "ubm.feed.%u", feed_next_id++);
+    f->obj.name = f->name;
+    f->obj.type = &feed_type;
+    f->obj.subscribe_cb = feed_subscribe_cb;
+    f->groups = groups;
+    f->interval = interval;
+    f->delta = delta;
+    f->created = get_monotonic_ms();
+
+    if (ubus_add_object(feeds_ctx, &f->obj) != 0) {
+        syslog(LOG_ERR, "Failed to add the %s UBus object!", f->name);
+        free(f);
+        return NULL;
+    }
+
+    f->next = feeds;
+    feeds = f;
+    feed_count++;
+    return f;
+}
+
+void feeds_cleanup() {
+    while (feeds != NULL) {
+        feed* f = feeds;
+        feeds = f->next;
+        if (feeds_ctx != NULL)
+            feed_remove(f);
+        else
+            free(f);
+    }
+    feed_count = 0;
+
+    for (unsigned i = 0; i < FEED_MAX_GROUPS; i++)
+        blob_buf_free(&group_bufs[i]);
+}
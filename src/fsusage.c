@@ -0,0 +1,210 @@
+#include "../includes/fsusage.h"
+#include "../includes/helpers.h"
+
+/* two tables alternate, the mount strings of each live in an arena of its own */
+static fs_table tables[2];
+static arena mount_arenas[2];
+static int current = -1;
+static bool collected = false;
+
+/* changes of the mount table seen by the watch and the change every table was parsed at,
+ * the counter is bumped on the event loop and read by the collector */
+static unsigned mount_changes = 1;
+static unsigned parsed_changes[2];
+static struct uloop_fd mountinfo_watch = { .fd = -1 };
+
+/* statvfs on a remote filesystem blocks the whole daemon while the server is unreachable */
+static const char* remote_types[] = { "nfs", "nfs4", "cifs", "smb3", "smbfs", "9p", "fuse.sshfs" };
+
+/* The kernel flags a changed mount table by reporting POLLPRI | POLLERR, polling clears it again */
+static void mountinfo_watch_cb(struct uloop_fd* u, unsigned int events) {
+    u->error = false;
+    __atomic_add_fetch(&mount_changes, 1, __ATOMIC_RELAXED);
+}
+
+/* Copies the next space separated field, undoing the octal escapes of spaces, tabs and newlines */
+static const char* mount_field(arena* a, const char** p) {
+    const char* c = *p;
+    while (*c == ' ')
+        c++;
+
+    const char* end = c;
+    while (*end != ' ' && *end != '\n' && *end != '\0')
+        end++;
+
+    char* field = (char*) arena_alloc(a, end - c + 1);
+    if (field == NULL)
+        return NULL;
+
+    char* out = field;
+    while (c < end) {
+        if (c[0] == '\\' && end - c >= 4 && c[1] >= '0' && c[1] <= '3') {
+            *out++ = (char)((c[1] - '0') << 6 | (c[2] - '0') << 3 | (c[3] - '0'));
+            c += 4;
+        } else {
+            *out++ = *c++;
+        }
+    }
+    *out = '\0';
+    *p = end;
+    return field;
+}
+
+static void mount_skip(const char** p, unsigned fields) {
+    const char* c = *p;
+    while (fields-- > 0) {
+        while (*c == ' ')
+            c++;
+        while (*c != ' ' && *c != '\n' && *c != '\0')
+            c++;
+    }
+    *p = c;
+}
+
+static bool mount_remote(const char* fstype) {
+    for (unsigned i = 0; i < sizeof(remote_types) / sizeof(remote_types[0]); i++) {
+        if (strcmp(fstype, remote_types[i]) == 0)
+            return true;
+    }
+    return false;
+}
+
+static int mounts_parse(int slot) {
+    const char* data = procfs_read(PROCFS_MOUNTINFO, NULL);
+    if (data == NULL)
+        return -1;
+
+    unsigned lines = 0;
+    for (const char* line = data; *line != '\0'; line = procfs_next_line(line))
+        lines++;
+
+    arena* a = &mount_arenas[slot];
+    fs_table* table = &tables[slot];
+    arena_reset(a);
+    table->mount_count = 0;
+    table->mounts = (fs_mount*) arena_calloc(a, lines, sizeof(fs_mount));
+    if (table->mounts == NULL)
+        return -1;
+
+    for (const char* line = data; *line != '\0'; line = procfs_next_line(line)) {
+        /* the kernel terminates every entry, a line without newline is not a complete one */
+        const char* eol = strchr(line, '\n');
+        if (eol == NULL)
+            break;
+
+        /* mount ID, parent ID, major:minor and root precede the mount point */
+        const char* p = line;
+        mount_skip(&p, 4);
+        const char* target = mount_field(a, &p);
+
+        /* the optional fields end with a lone "-" */
+        const char* sep = strstr(p, " - ");
+        if (target == NULL || sep == NULL || sep > eol)
+            continue;
+
+        p = sep + 3;
+        const char* fstype = mount_field(a, &p);
+        const char* source = mount_field(a, &p);
+        if (fstype == NULL || source == NULL || mount_remote(fstype))
+            continue;
+
+        /* a mount hides the earlier ones on the same mount point */
+        unsigned i;
+        for (i = 0; i < table->mount_count; i++) {
+            if (strcmp(table->mounts[i].target, target) == 0)
+                break;
+        }
+        if (i == table->mount_count)
+            table->mount_count++;
+
+        fs_mount* mount = &table->mounts[i];
+        mount->target = target;
+        mount->source = source;
+        mount->fstype = fstype;
+    }
+    return 0;
+}
+
+/* Fills the table the event loop is not reading, it is parsed again if the mounts changed since */
+static void fsusage_collect() {
+    int next = current == 0 ? 1 : 0;
+    collected = false;
+
+    unsigned changes = __atomic_load_n(&mount_changes, __ATOMIC_RELAXED);
+    if (parsed_changes[next] != changes || mountinfo_watch.fd < 0) {
+        if (mounts_parse(next) != 0) {
+            syslog(LOG_WARNING, "Failed to parse the mount table");
+            parsed_changes[next] = 0;
+            return;
+        }
+        parsed_changes[next] = changes;
+    }
+
+    fs_table* table = &tables[next];
+    for (unsigned i = 0; i < table->mount_count; i++) {
+        fs_mount* mount = &table->mounts[i];
+        struct statvfs st;
+        mount->valid = statvfs(mount->target, &st) == 0 && st.f_blocks > 0;
+        if (!mount->valid)
+            continue;
+
+        uint64_t frsize = st.f_frsize ? st.f_frsize : st.f_bsize;
+        mount->readonly = (st.f_flag & ST_RDONLY) != 0;
+        mount->total = (uint64_t)st.f_blocks * frsize;
+        mount->free = (uint64_t)st.f_bfree * frsize;
+        mount->available = (uint64_t)st.f_bavail * frsize;
+        mount->inodes = st.f_files;
+        mount->inodes_free = st.f_ffree;
+
+        uint64_t used = st.f_blocks - st.f_bfree;
+        uint64_t usable = used + st.f_bavail;
+        mount->used_percent = usable ? 100.0 * used / usable : 0;
+        mount->inodes_percent = st.f_files ? 100.0 * (st.f_files - st.f_ffree) / st.f_files : 0;
+    }
+    table->sampled = get_timestamp();
+    collected = true;
+}
+
+static void fsusage_publish() {
+    if (collected)
+        current = current == 0 ? 1 : 0;
+    collected = false;
+}
+
+static sampler_hook fsusage_hook = { .name = "fsusage", .collect = fsusage_collect, .cb = fsusage_publish };
+
+int fsusage_init() {
+    sampler_add(&fsusage_hook);
+
+    mountinfo_watch.fd = procfs_fd(PROCFS_MOUNTINFO);
+    if (mountinfo_watch.fd < 0) {
+        syslog(LOG_WARNING, "Failed to watch the mount table, it will be parsed on every sample");
+        return -1;
+    }
+
+    /* the table is always readable, only the error condition signals a change */
+    mountinfo_watch.cb = mountinfo_watch_cb;
+    uloop_fd_add(&mountinfo_watch, ULOOP_ERROR_CB);
+    return 0;
+}
+
+const fs_table* get_fs_table() {
+    return current < 0 ? NULL : &tables[current];
+}
+
+void fsusage_cleanup() {
+    /* the descriptor belongs to the procfs reader */
+    if (mountinfo_watch.fd >= 0) {
+        uloop_fd_delete(&mountinfo_watch);
+        mountinfo_watch.fd = -1;
+    }
+
+    for (int i = 0; i < 2; i++) {
+        arena_free(&mount_arenas[i]);
+        memset(&tables[i], 0, sizeof(fs_table));
+        parsed_changes[i] = 0;
+    }
+    current = -1;
+    collected = false;
+    mount_changes = 1;
+}
@@ -1,426 +1,476 @@
 #include "../includes/helpers.h"
+#include "../includes/netdev.h"
 
-char* get_uptime() {
-    FILE* fp = fopen("/proc/uptime", "r");
-    if (fp == NULL) {
-        syslog(LOG_WARNING, "Failed to open /proc/uptime");
-        return strdup("unable to open /proc/uptime");
-    }
-
-    double uptime = -1.0;
-    if (fscanf(fp, "%lf", &uptime) != 1) {
-        fclose(fp);
-        syslog(LOG_WARNING, "Failed to read uptime from /proc/uptime");
-        return strdup("failed to read uptime}");
-    }
-    fclose(fp);
+long get_uptime() {
+    const char* data = procfs_read(PROCFS_UPTIME, NULL);
+    if (data == NULL)
+        return -1;
 
-    char* result = (char*)malloc(32);
-    if (result == NULL) {
-        syslog(LOG_CRIT, "Memory allocation failed in get_uptime");
-        return strdup("memory allocation failed");
-    }
-    
-    snprintf(result, 32, "%d", (int)uptime);
-    return result;
+    return (long)procfs_scan_u64(&data);
 }
 
 unsigned get_timestamp() {
     return (unsigned)time(NULL);
 }
 
-cpu_info* get_cpu_info() {
-    FILE* fp = fopen("/proc/cpuinfo", "r");
-    if (fp == NULL) {
-        syslog(LOG_WARNING, "Failed to open /proc/cpuinfo");
+uint64_t get_monotonic_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+uint64_t get_realtime_ms() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+bool get_load_info(load_info* load) {
+    const char* data = procfs_read(PROCFS_LOADAVG, NULL);
+    if (data == NULL)
+        return false;
+
+    return sscanf(data, "%lf %lf %lf %u/%u", &load->load1, &load->load5, &load->load15,
+        &load->running, &load->total) == 5;
+}
+
+/* Commits a parsed /proc/cpuinfo block unless its physical package was already indexed
+ * or the array sized by cpu_block_count is already full */
+static void cpu_block_commit(cpu_info* cpu, unsigned cpus_max, const _cpu_info* block) {
+    if (cpu->cpus_active == cpus_max)
+        return;
+
+    for (unsigned i = 0; i < cpu->cpus_active; i++) {
+        if (cpu->cpus[i].physical_id == block->physical_id)
+            return;
+    }
+
+    memcpy(&cpu->cpus[cpu->cpus_active++], block, sizeof(_cpu_info));
+}
+
+/* Every package has at least one processor, so their count bounds the array */
+static unsigned cpu_block_count(const char* data) {
+    unsigned count = 0;
+    for (const char* line = data; *line != '\0'; line = procfs_next_line(line)) {
+        if (procfs_field(line, "processor") != NULL)
+            count++;
+    }
+    return count;
+}
+
+cpu_info* get_cpu_info(arena* a) {
+    /* procfs_read hands out the whole file or nothing, so the count below covers every block */
+    const char* data = procfs_read(PROCFS_CPUINFO, NULL);
+    if (data == NULL)
+        return NULL;
+
+    unsigned cpus_max = cpu_block_count(data);
+    if (cpus_max == 0) {
+        syslog(LOG_WARNING, "No processor entries found in /proc/cpuinfo!");
         return NULL;
     }
 
-    cpu_info* cpu = (cpu_info*) malloc(sizeof(cpu_info));
+    cpu_info* cpu = (cpu_info*) arena_alloc(a, sizeof(cpu_info));
     if (cpu == NULL) {
-        fclose(fp);
         syslog(LOG_WARNING, "Failed allocate memory for cpu_info struct!");
         return NULL;
     }
 
     cpu->cpus_active = 0;
-    for (int i = 0; i < MAX_CPUS; i++)
-        cpu->cpus[i] = NULL;
+    cpu->cpus = (_cpu_info*) arena_alloc(a, cpus_max * sizeof(_cpu_info));
+    if (cpu->cpus == NULL) {
+        syslog(LOG_WARNING, "Failed allocate memory for _cpu_info array!");
+        return NULL;
+    }
 
-    char buffer[512];
     _cpu_info c_cpu;
-    unsigned cpu_index = 0;
-    int processed_ids[MAX_CPUS];
-    for (int i = 0; i < MAX_CPUS; i++)
-        processed_ids[i] = -1;
-
-    while(fgets(buffer, sizeof(buffer), fp)) {
-        if (strncmp(buffer, "processor", 9) == 0) {
-            if (cpu_index > 0 && cpu_index <= MAX_CPUS) {
-                cpu->cpus[cpu_index - 1] = (_cpu_info*) malloc(sizeof(_cpu_info));
-                memcpy(cpu->cpus[cpu_index - 1], &c_cpu, sizeof(_cpu_info));
-            }
+    bool in_block = false;
+    const char* value;
+    for (const char* line = data; *line != '\0'; line = procfs_next_line(line)) {
+        if ((value = procfs_field(line, "processor")) != NULL) {
+            if (in_block)
+                cpu_block_commit(cpu, cpus_max, &c_cpu);
             memset(&c_cpu, 0, sizeof(_cpu_info));
-        }
-        
-        if (strncmp(buffer, "vendor_id", 9) == 0) {
-            if (c_cpu.vendor != NULL)
-                free(c_cpu.vendor);
-            c_cpu.vendor = strdup(strchr(buffer, ':') + 2);
-            c_cpu.vendor[strcspn(c_cpu.vendor, "\n")] = '\0';
-        }
-
-        if (strncmp(buffer, "model name", 10) == 0) {
-            if (c_cpu.model != NULL)
-                free(c_cpu.model);
-            c_cpu.model = strdup(strchr(buffer, ':') + 2);
-            c_cpu.model[strcspn(c_cpu.model, "\n")] = '\0';
-        }
-
-        if (strncmp(buffer, "cpu cores", 9) == 0)
-            sscanf(strchr(buffer, ':') + 2, "%u", &c_cpu.cores);
-
-        if (strncmp(buffer, "cache size", 10) == 0)
-            sscanf(strchr(buffer, ':') + 2, "%u", &c_cpu.cache_size);
-
-        if (strncmp(buffer, "cpu MHz", 7) == 0)
-            sscanf(strchr(buffer, ':') + 2, "%lf", &c_cpu.cpu_mhz);
-        
-        if (strncmp(buffer, "cache_alignment", 15) == 0)
-            sscanf(strchr(buffer, ':') + 2, "%u", &c_cpu.cache_align);
-
-        if (strncmp(buffer, "address sizes", 13) == 0) {
-            if (c_cpu.address_sizes != NULL)
-                free(c_cpu.address_sizes);
-            c_cpu.address_sizes = strdup(strchr(buffer, ':') + 2);
-            c_cpu.address_sizes[strcspn(c_cpu.address_sizes, "\n")] = '\0';
-        }
-
-        if (strncmp(buffer, "physical id", 11) == 0) {
-            sscanf(strchr(buffer, ':') + 2, "%u", &c_cpu.physical_id);
-            bool processed = false;
-            for (int i = 0; i < MAX_CPUS; i++) {
-                if (processed_ids[i] == c_cpu.physical_id) {
-                    processed = true;
-                    break;
-                }
-            }
-
-            if (processed) {
-                while((fgets(buffer, sizeof(buffer), fp)) && strncmp(buffer, "processor", 9) != 0);
-                continue;
-            } else {
-                if (cpu_index < MAX_CPUS) {
-                    processed_ids[cpu_index] = c_cpu.physical_id;
-                    cpu_index++;
-                    cpu->cpus_active = cpu_index;
-                } else {
-                    while((fgets(buffer, sizeof(buffer), fp)) && strncmp(buffer, "processor", 9) != 0);
-                    continue;
-                }
-            }
+            in_block = true;
+        } else if ((value = procfs_field(line, "vendor_id")) != NULL) {
+            procfs_copy_value(c_cpu.vendor, sizeof(c_cpu.vendor), value);
+        } else if ((value = procfs_field(line, "model name")) != NULL) {
+            procfs_copy_value(c_cpu.model, sizeof(c_cpu.model), value);
+        } else if ((value = procfs_field(line, "cpu cores")) != NULL) {
+            c_cpu.cores = (unsigned)procfs_scan_u64(&value);
+        } else if ((value = procfs_field(line, "cache size")) != NULL) {
+            c_cpu.cache_size = (unsigned)procfs_scan_u64(&value);
+        } else if ((value = procfs_field(line, "cache_alignment")) != NULL) {
+            c_cpu.cache_align = (unsigned)procfs_scan_u64(&value);
+        } else if ((value = procfs_field(line, "address sizes")) != NULL) {
+            procfs_copy_value(c_cpu.address_sizes, sizeof(c_cpu.address_sizes), value);
+        } else if ((value = procfs_field(line, "physical id")) != NULL) {
+            c_cpu.physical_id = (unsigned)procfs_scan_u64(&value);
         }
     }
-    fclose(fp);
 
-    free(c_cpu.vendor);
-    free(c_cpu.model);
-    free(c_cpu.address_sizes);
+    if (in_block)
+        cpu_block_commit(cpu, cpus_max, &c_cpu);
     return cpu;
 }
 
-char* get_current_user() {
-    FILE* fp;
-    char buffer[32+1];
+static const char* const meminfo_names[__MEMINFO_MAX] = {
+    [MEMINFO_MEM_TOTAL] = "MemTotal",
+    [MEMINFO_MEM_FREE] = "MemFree",
+    [MEMINFO_MEM_AVAILABLE] = "MemAvailable",
+    [MEMINFO_BUFFERS] = "Buffers",
+    [MEMINFO_CACHED] = "Cached",
+    [MEMINFO_SWAP_CACHED] = "SwapCached",
+    [MEMINFO_ACTIVE] = "Active",
+    [MEMINFO_INACTIVE] = "Inactive",
+    [MEMINFO_ACTIVE_ANON] = "Active(anon)",
+    [MEMINFO_INACTIVE_ANON] = "Inactive(anon)",
+    [MEMINFO_ACTIVE_FILE] = "Active(file)",
+    [MEMINFO_INACTIVE_FILE] = "Inactive(file)",
+    [MEMINFO_UNEVICTABLE] = "Unevictable",
+    [MEMINFO_MLOCKED] = "Mlocked",
+    [MEMINFO_HIGH_TOTAL] = "HighTotal",
+    [MEMINFO_HIGH_FREE] = "HighFree",
+    [MEMINFO_LOW_TOTAL] = "LowTotal",
+    [MEMINFO_LOW_FREE] = "LowFree",
+    [MEMINFO_SWAP_TOTAL] = "SwapTotal",
+    [MEMINFO_SWAP_FREE] = "SwapFree",
+    [MEMINFO_ZSWAP] = "Zswap",
+    [MEMINFO_ZSWAPPED] = "Zswapped",
+    [MEMINFO_DIRTY] = "Dirty",
+    [MEMINFO_WRITEBACK] = "Writeback",
+    [MEMINFO_ANON_PAGES] = "AnonPages",
+    [MEMINFO_MAPPED] = "Mapped",
+    [MEMINFO_SHMEM] = "Shmem",
+    [MEMINFO_KRECLAIMABLE] = "KReclaimable",
+    [MEMINFO_SLAB] = "Slab",
+    [MEMINFO_SRECLAIMABLE] = "SReclaimable",
+    [MEMINFO_SUNRECLAIM] = "SUnreclaim",
+    [MEMINFO_KERNEL_STACK] = "KernelStack",
+    [MEMINFO_SHADOW_CALL_STACK] = "ShadowCallStack",
+    [MEMINFO_PAGE_TABLES] = "PageTables",
+    [MEMINFO_SEC_PAGE_TABLES] = "SecPageTables",
+    [MEMINFO_NFS_UNSTABLE] = "NFS_Unstable",
+    [MEMINFO_BOUNCE] = "Bounce",
+    [MEMINFO_WRITEBACK_TMP] = "WritebackTmp",
+    [MEMINFO_COMMIT_LIMIT] = "CommitLimit",
+    [MEMINFO_COMMITTED_AS] = "Committed_AS",
+    [MEMINFO_VMALLOC_TOTAL] = "VmallocTotal",
+    [MEMINFO_VMALLOC_USED] = "VmallocUsed",
+    [MEMINFO_VMALLOC_CHUNK] = "VmallocChunk",
+    [MEMINFO_PERCPU] = "Percpu",
+    [MEMINFO_HARDWARE_CORRUPTED] = "HardwareCorrupted",
+    [MEMINFO_ANON_HUGE_PAGES] = "AnonHugePages",
+    [MEMINFO_SHMEM_HUGE_PAGES] = "ShmemHugePages",
+    [MEMINFO_SHMEM_PMD_MAPPED] = "ShmemPmdMapped",
+    [MEMINFO_FILE_HUGE_PAGES] = "FileHugePages",
+    [MEMINFO_FILE_PMD_MAPPED] = "FilePmdMapped",
+    [MEMINFO_CMA_TOTAL] = "CmaTotal",
+    [MEMINFO_CMA_FREE] = "CmaFree",
+    [MEMINFO_UNACCEPTED] = "Unaccepted",
+    [MEMINFO_HUGE_PAGES_TOTAL] = "HugePages_Total",
+    [MEMINFO_HUGE_PAGES_FREE] = "HugePages_Free",
+    [MEMINFO_HUGE_PAGES_RSVD] = "HugePages_Rsvd",
+    [MEMINFO_HUGE_PAGES_SURP] = "HugePages_Surp",
+    [MEMINFO_HUGEPAGESIZE] = "Hugepagesize",
+    [MEMINFO_HUGETLB] = "Hugetlb",
+    [MEMINFO_DIRECT_MAP_4K] = "DirectMap4k",
+    [MEMINFO_DIRECT_MAP_4M] = "DirectMap4M",
+    [MEMINFO_DIRECT_MAP_2M] = "DirectMap2M",
+    [MEMINFO_DIRECT_MAP_1G] = "DirectMap1G",
+};
+
+/* Fields ordered by name for the binary search */
+static const unsigned char meminfo_sorted[__MEMINFO_MAX] = {
+    MEMINFO_ACTIVE,
+    MEMINFO_ACTIVE_ANON,
+    MEMINFO_ACTIVE_FILE,
+    MEMINFO_ANON_HUGE_PAGES,
+    MEMINFO_ANON_PAGES,
+    MEMINFO_BOUNCE,
+    MEMINFO_BUFFERS,
+    MEMINFO_CACHED,
+    MEMINFO_CMA_FREE,
+    MEMINFO_CMA_TOTAL,
+    MEMINFO_COMMIT_LIMIT,
+    MEMINFO_COMMITTED_AS,
+    MEMINFO_DIRECT_MAP_1G,
+    MEMINFO_DIRECT_MAP_2M,
+    MEMINFO_DIRECT_MAP_4M,
+    MEMINFO_DIRECT_MAP_4K,
+    MEMINFO_DIRTY,
+    MEMINFO_FILE_HUGE_PAGES,
+    MEMINFO_FILE_PMD_MAPPED,
+    MEMINFO_HARDWARE_CORRUPTED,
+    MEMINFO_HIGH_FREE,
+    MEMINFO_HIGH_TOTAL,
+    MEMINFO_HUGE_PAGES_FREE,
+    MEMINFO_HUGE_PAGES_RSVD,
+    MEMINFO_HUGE_PAGES_SURP,
+    MEMINFO_HUGE_PAGES_TOTAL,
+    MEMINFO_HUGEPAGESIZE,
+    MEMINFO_HUGETLB,
+    MEMINFO_INACTIVE,
+    MEMINFO_INACTIVE_ANON,
+    MEMINFO_INACTIVE_FILE,
+    MEMINFO_KRECLAIMABLE,
+    MEMINFO_KERNEL_STACK,
+    MEMINFO_LOW_FREE,
+    MEMINFO_LOW_TOTAL,
+    MEMINFO_MAPPED,
+    MEMINFO_MEM_AVAILABLE,
+    MEMINFO_MEM_FREE,
+    MEMINFO_MEM_TOTAL,
+    MEMINFO_MLOCKED,
+    MEMINFO_NFS_UNSTABLE,
+    MEMINFO_PAGE_TABLES,
+    MEMINFO_PERCPU,
+    MEMINFO_SRECLAIMABLE,
+    MEMINFO_SUNRECLAIM,
+    MEMINFO_SEC_PAGE_TABLES,
+    MEMINFO_SHADOW_CALL_STACK,
+    MEMINFO_SHMEM,
+    MEMINFO_SHMEM_HUGE_PAGES,
+    MEMINFO_SHMEM_PMD_MAPPED,
+    MEMINFO_SLAB,
+    MEMINFO_SWAP_CACHED,
+    MEMINFO_SWAP_FREE,
+    MEMINFO_SWAP_TOTAL,
+    MEMINFO_UNACCEPTED,
+    MEMINFO_UNEVICTABLE,
+    MEMINFO_VMALLOC_CHUNK,
+    MEMINFO_VMALLOC_TOTAL,
+    MEMINFO_VMALLOC_USED,
+    MEMINFO_WRITEBACK,
+    MEMINFO_WRITEBACK_TMP,
+    MEMINFO_ZSWAP,
+    MEMINFO_ZSWAPPED,
+};
+
+/* Compares the first len bytes of key, which is not NUL-terminated, against a field name */
+static int meminfo_compare(const char* key, size_t len, const char* name) {
+    int rc = strncmp(key, name, len);
+    if (rc != 0)
+        return rc;
+    return name[len] == '\0' ? 0 : -1;
+}
 
-    fp = popen("who | awk '{print $1}' | sort -u", "r");
-    if (fp == NULL) {
-        syslog(LOG_ERR, "Failed to get the current user");
-        return "unknown";
+/* The kernel prints the fields in enum order, try the one after the previous match before searching */
+static int meminfo_lookup(const char* key, size_t len, unsigned hint) {
+    if (hint < __MEMINFO_MAX && meminfo_compare(key, len, meminfo_names[hint]) == 0)
+        return (int)hint;
+
+    unsigned lo = 0, hi = __MEMINFO_MAX;
+    while (lo < hi) {
+        unsigned mid = (lo + hi) / 2;
+        int rc = meminfo_compare(key, len, meminfo_names[meminfo_sorted[mid]]);
+        if (rc == 0)
+            return meminfo_sorted[mid];
+        if (rc < 0)
+            hi = mid;
+        else
+            lo = mid + 1;
     }
+    return -1;
+}
 
-    fgets(buffer, sizeof(buffer), fp);
-    buffer[strcspn(buffer, "\r\n")] = 0;
+int meminfo_field(const char* name) {
+    return meminfo_lookup(name, strlen(name), __MEMINFO_MAX);
+}
 
-    pclose(fp);
-    return strdup(buffer);
+const char* meminfo_name(unsigned field) {
+    return field < __MEMINFO_MAX ? meminfo_names[field] : NULL;
 }
 
-memory_info* get_mem_info() {
-    FILE* fp = fopen("/proc/meminfo", "r");
-    if (fp == NULL) {
-        syslog(LOG_WARNING, "Failed to open /proc/meminfo");
+memory_info* get_mem_info(arena* a) {
+    const char* data = procfs_read(PROCFS_MEMINFO, NULL);
+    if (data == NULL)
         return NULL;
-    }
 
-    memory_info* memory = (memory_info*) malloc(sizeof(memory_info));
+    memory_info* memory = (memory_info*) arena_calloc(a, 1, sizeof(memory_info));
     if (memory == NULL) {
-        fclose(fp);
         syslog(LOG_WARNING, "Failed allocate memory for memory_info struct!");
         return NULL;
     }
 
-    memory->memory_total = 0;
-    memory->memory_free = 0;
-    memory->memory_available = 0;
-    memory->memory_cached = 0;
-    memory->swap_memory = (swap_info*) malloc(sizeof(swap_info));
-    if (memory->swap_memory != NULL) {
-        memory->swap_memory->swap_total = 0;
-        memory->swap_memory->swap_cached = 0;
-        memory->swap_memory->swap_free = 0;
-    } 
-
-    char buffer[256];
-    while(fgets(buffer, sizeof(buffer), fp)) {
-        if (strncmp(buffer, "MemTotal", 8) == 0) {
-            sscanf(strchr(buffer, ':') + 2, "%u", &memory->memory_total);
-        }
-
-        if (strncmp(buffer, "MemFree", 7) == 0) {
-            sscanf(strchr(buffer, ':') + 2, "%u", &memory->memory_free);
-        }
-
-        if (strncmp(buffer, "MemAvailable", 12) == 0) {
-            sscanf(strchr(buffer, ':') + 2, "%u", &memory->memory_available);
-        }
-
-        if (strncmp(buffer, "Cached", 6) == 0) {
-            sscanf(strchr(buffer, ':') + 2, "%u", &memory->memory_cached);
-        }
-
-        if (strncmp(buffer, "SwapTotal", 9) == 0) {
-            if (memory->swap_memory != NULL)
-                sscanf(strchr(buffer, ':') + 2, "%u", &memory->swap_memory->swap_total);
-        }
+    unsigned hint = 0;
+    for (const char* line = data; *line != '\0'; line = procfs_next_line(line)) {
+        const char* colon = line;
+        while (*colon != ':' && *colon != '\n' && *colon != '\0')
+            colon++;
+        if (*colon != ':')
+            continue;
 
-        if (strncmp(buffer, "SwapCached", 10) == 0) {
-            if (memory->swap_memory != NULL)
-                sscanf(strchr(buffer, ':') + 2, "%u", &memory->swap_memory->swap_cached);
-        }
+        int field = meminfo_lookup(line, (size_t)(colon - line), hint);
+        if (field < 0)
+            continue;
 
-        if (strncmp(buffer, "SwapFree", 8) == 0) {
-            if (memory->swap_memory != NULL)
-                sscanf(strchr(buffer, ':') + 2, "%u", &memory->swap_memory->swap_free);
-        }
+        const char* value = colon + 1;
+        memory->values[field] = procfs_scan_u64(&value);
+        memory->present |= (uint64_t)1 << field;
+        hint = (unsigned)field + 1;
     }
-    fclose(fp);
     return memory;
 }
 
-network_info* get_net_info() {
-    struct ifaddrs *addrs, *tmp;
-    if (getifaddrs(&addrs) == -1) {
-        syslog(LOG_ERR, "Failed to obtain network interfaces.");
+network_info* get_net_info(arena* a) {
+    const network_info* table = get_netdev_table();
+    if (table == NULL)
         return NULL;
-    }
 
-    network_info* net_info = (network_info*) malloc(sizeof(network_info));
-    if (net_info == NULL) {
+    network_info* net_info = (network_info*) arena_alloc(a, sizeof(network_info));
+    _network* interfaces = (_network*) arena_alloc(a, table->interface_count * sizeof(_network));
+    net_address* addresses = (net_address*) arena_alloc(a, table->address_count * sizeof(net_address));
+    if (net_info == NULL || interfaces == NULL || addresses == NULL) {
         syslog(LOG_ERR, "Failed to allocate memory for network_info struct!");
-        freeifaddrs(addrs);
         return NULL;
     }
 
-    for (int i = 0; i < MAX_NETINT; i++)
-        net_info->interfaces[i] = NULL;
-
-    net_info->interface_count = 0;
-    tmp = addrs;
-
-    while (tmp) {
-
-        if (net_info->interface_count >= MAX_NETINT)
-            break;
-
-        if (tmp->ifa_addr->sa_family != AF_PACKET) {
-            tmp = tmp->ifa_next;
-            continue;
-        }
-
-        _network* c_net = net_info->interfaces[net_info->interface_count];
-        c_net = (_network*) malloc(sizeof(_network));
-        if (c_net == NULL) {
-            syslog(LOG_ERR, "Failed to allocate memory for _network struct!");
-            return NULL;
-        }
-        
-        c_net->ni_name = strdup(tmp->ifa_name);
-        c_net->ni_flags = tmp->ifa_flags;
-
-        net_info->interfaces[net_info->interface_count] = c_net;
-        net_info->interface_count++;
-        tmp = tmp->ifa_next;
-    }
-    freeifaddrs(addrs);
+    net_info->interface_count = table->interface_count;
+    net_info->interfaces = interfaces;
+    memcpy(interfaces, table->interfaces, table->interface_count * sizeof(_network));
+    net_info->address_count = table->address_count;
+    net_info->addresses = addresses;
+    memcpy(addresses, table->addresses, table->address_count * sizeof(net_address));
     return net_info;
 }
 
-void blank_sysinf_init(system_info** s) {
-    if (s == NULL)
-        return;
-    
-    if ((*s) != NULL) {
-        syslog(LOG_ERR, "Blank initialization could not be performed. The pointer is not NULL!");
-        return;
-    }
-
-    (*s) = (system_info*) malloc(sizeof(system_info));
-    if ((*s) == NULL) {
-        syslog(LOG_CRIT, "Failed to allocate memory for the system_info object!");
-        return;
+/* Skips whitespace separated fields, some of them may be negative */
+static const char* skip_fields(const char* p, unsigned count) {
+    while (count-- > 0) {
+        while (*p == ' ')
+            p++;
+        while (*p != ' ' && *p != '\0')
+            p++;
     }
+    return p;
+}
 
-    (*s)->cpu = NULL;
-    (*s)->memory = NULL;
-    (*s)->network = NULL;
-    (*s)->current_user = NULL;
+bool pid_lookup(int pid, process* proc) {
+    char buffer[1024];
+    if (pid <= 0 || procfs_read_pid(pid, "stat", buffer, sizeof(buffer)) < 0)
+        return false;
+    return pid_stat_parse(pid, buffer, proc);
 }
 
-system_info* get_system_info_obj() {
-    system_info* sys_info = (system_info*) malloc(sizeof(system_info));
-    if (sys_info == NULL) {
-        syslog(LOG_WARNING, "Failed allocate memory for system_info struct!");
-        return NULL;
+bool pid_stat_parse(int pid, const char* buffer, process* proc) {
+    /* the name may itself contain parentheses, it ends at the last ')' */
+    const char* name_start = strchr(buffer, '(');
+    const char* name_end = strrchr(buffer, ')');
+    if (name_start == NULL || name_end == NULL || name_end < name_start || name_end[1] != ' ') {
+        syslog(LOG_ERR, "Failed to parse /proc/%d/stat!", pid);
+        return false;
     }
 
-    sys_info->cpu = get_cpu_info();
-    sys_info->memory = get_mem_info();
-    sys_info->network = get_net_info();
-    sys_info->current_user = get_current_user();
-    return sys_info;
+    size_t name_len = name_end - name_start - 1;
+    if (name_len >= sizeof(proc->process_name))
+        name_len = sizeof(proc->process_name) - 1;
+    memcpy(proc->process_name, name_start + 1, name_len);
+    proc->process_name[name_len] = '\0';
+
+    /* fields are numbered as in proc(5), the state is field 3 */
+    const char* p = name_end + 2;
+    proc->state = *p++;
+    proc->ppid = (unsigned)procfs_scan_u64(&p);
+    p = skip_fields(p, 9);
+    proc->utime = procfs_scan_u64(&p);
+    proc->stime = procfs_scan_u64(&p);
+    p = skip_fields(p, 4);
+    proc->threads = (unsigned)procfs_scan_u64(&p);
+    p = skip_fields(p, 1);
+    proc->start_time = procfs_scan_u64(&p);
+    proc->vsz = procfs_scan_u64(&p);
+    proc->rss = procfs_scan_u64(&p) * (uint64_t)sysconf(_SC_PAGESIZE);
+    proc->pid = pid;
+    return true;
 }
 
-void get_system_info(system_info** s) {
-    if (s == NULL) {
-        syslog(LOG_ERR, "get_system_info method received a null pointer!");
-        return;
-    }
-
-    if (*s == NULL) {
-        *s = get_system_info_obj();
-        return;
-    }
+static int pidfd_open_compat(int pid) {
+#ifdef SYS_pidfd_open
+    return (int)syscall(SYS_pidfd_open, pid, 0);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
 
-    (*s)->cpu = get_cpu_info();
-    (*s)->memory = get_mem_info();
-    (*s)->network = get_net_info();
-    (*s)->current_user = get_current_user();
+static int pidfd_send_signal_compat(int pidfd, int signal_id) {
+#ifdef SYS_pidfd_send_signal
+    return (int)syscall(SYS_pidfd_send_signal, pidfd, signal_id, NULL, 0);
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
 }
 
-process* pid_lookup(int pid) {
-    FILE* fp = NULL;
-    char exec_buffer[32];
-    sprintf(exec_buffer, "cat /proc/%d/stat 2>/dev/null", pid);
-    fp = popen(exec_buffer, "r");
-    if (fp == NULL) {
-        syslog(LOG_ERR, "Failed to open stream for pid lookup!");
-        return NULL;
-    }
-    
-    int ppid;
-    char state;
-    char proc_name[256];
-    if (fscanf(fp, "%*d (%[^)]) %c %d", proc_name, &state, &ppid) != 3) {
-        pclose(fp);
-        syslog(LOG_ERR, "Failed to read stat file!");
-        return NULL;
+/* Pins the process with a pidfd, optionally verifies its name and signals it */
+static int signal_process(int pid, const char* name, int signal_id) {
+    if (pid <= 0)
+        return ESRCH;
+    if (signal_id < 0 || signal_id >= NSIG)
+        return EINVAL;
+
+    int pidfd = pidfd_open_compat(pid);
+    if (pidfd < 0 && errno != ENOSYS)
+        return errno;
+
+    /* once the pidfd is open the pid can not be recycled, so a name
+     * check done now still refers to the process that gets signalled */
+    if (name != NULL) {
+        process proc;
+        if (!pid_lookup(pid, &proc) || strcmp(proc.process_name, name) != 0) {
+            if (pidfd >= 0)
+                close(pidfd);
+            return ESRCH;
+        }
     }
-    pclose(fp);
 
-    process* proc = (process*) malloc(sizeof(process));
-    if (proc == NULL) {
-        syslog(LOG_ERR, "Failed to allocate memory for process struct!");
-        return NULL;
+    int rc;
+    if (pidfd >= 0) {
+        rc = pidfd_send_signal_compat(pidfd, signal_id);
+        if (rc < 0 && errno == ENOSYS)
+            rc = kill(pid, signal_id);
+        close(pidfd);
+    } else {
+        rc = kill(pid, signal_id);
     }
-
-    proc->pid = pid;
-    proc->ppid = ppid;
-    proc->state = state;
-    strcpy(proc->process_name, proc_name);
-    return proc;
+    return rc < 0 ? errno : 0;
 }
 
-char* send_signal(int pid, int signal_id) {
-    FILE* fp = NULL;
-    char exec_buffer[32];
-    sprintf(exec_buffer, "/bin/kill -%d %d 2>&1", signal_id, pid);
-    fp = popen(exec_buffer, "r");
-    if (fp == NULL)
-        return strdup("failed to create a pipe");
-
-    char buffer[256] = {0};
-    while (fgets(buffer, sizeof(buffer), fp) != NULL);
-    
-    pclose(fp);
-    if (strlen(buffer) == 0)
-        return NULL;
-
-    if (strstr(buffer, "No such process") != NULL)
-        return strdup("pid is not reserved");
-
-    return strdup(buffer);
+int send_signal(int pid, int signal_id) {
+    return signal_process(pid, NULL, signal_id);
 }
 
-void cpuinf_cleanup(cpu_info** c) {
-    if (*c == NULL)
-        return;
-    
-    for (int i = 0; i < MAX_CPUS; i++) {
-        _cpu_info* cpu_data = (*c)->cpus[i];
-        if (cpu_data != NULL) {
-            if (cpu_data->model != NULL)
-                free(cpu_data->model);
-            if (cpu_data->vendor != NULL) 
-                free(cpu_data->vendor);
-            if (cpu_data->address_sizes != NULL) 
-                free(cpu_data->address_sizes);
-            free(cpu_data);
-        }
+unsigned send_signal_by_name(const char* name, int signal_id, signal_result* results, unsigned max) {
+    DIR* dir = opendir(procfs_root());
+    if (dir == NULL) {
+        syslog(LOG_ERR, "Failed to open %s for process lookup!", procfs_root());
+        return 0;
     }
 
-    free(*c);
-    *c = NULL;
-}
+    unsigned count = 0;
+    struct dirent* entry;
+    while (count < max && (entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] < '1' || entry->d_name[0] > '9')
+            continue;
 
-void meminf_cleanup(memory_info** m) {
-    if (*m == NULL)
-        return;
-    
-    if ((*m)->swap_memory != NULL) {
-        free((*m)->swap_memory);
-        (*m)->swap_memory = NULL;
-    }
+        const char* p = entry->d_name;
+        int pid = (int)procfs_scan_u64(&p);
+        if (*p != '\0' || pid == getpid())
+            continue;
 
-    free(*m);
-    *m = NULL;
-}
+        process proc;
+        if (!pid_lookup(pid, &proc) || strcmp(proc.process_name, name) != 0)
+            continue;
 
-void netinf_cleanup(network_info** n) {
-    if (*n == NULL)
-        return;
+        int rc = signal_process(pid, name, signal_id);
+        if (rc == ESRCH)
+            continue;
 
-    network_info* netinf = *n;
-    for (int i = 0; i < netinf->interface_count; i++) {
-        _network* network = netinf->interfaces[i];
-        if (network == NULL) continue;
-        if (network->ni_name) free(network->ni_name);
-        free(netinf->interfaces[i]);
-        netinf->interfaces[i] = NULL;
+        results[count].pid = pid;
+        results[count].error = rc;
+        count++;
     }
-
-    free(netinf);
-    (*n) = NULL;
+    closedir(dir);
+    return count;
 }
-
-void sysinf_cleanup(system_info** s) {
-    if (s == NULL || *s == NULL)
-        return;
-    
-    cpuinf_cleanup(&((*s)->cpu));
-    meminf_cleanup(&((*s)->memory));
-    netinf_cleanup(&((*s)->network));
-    free((*s)->current_user);
-    free(*s);
-    *s = NULL;
-}
\ No newline at end of file
@@ -0,0 +1,114 @@
+#include "../includes/history.h"
+
+_Static_assert(sizeof(history_header) == 64, "history_header must stay one cache line");
+_Static_assert(sizeof(history_record) == 48, "history_record layout changed, bump HISTORY_VERSION");
+
+static history_header* header = NULL;
+static history_record* records = NULL;
+static size_t mapped_size = 0;
+
+static bool history_valid(unsigned capacity) {
+    return header->magic == HISTORY_MAGIC && header->version == HISTORY_VERSION
+        && header->record_size == sizeof(history_record) && header->capacity == capacity;
+}
+
+static void history_reset(unsigned capacity) {
+    memset(header, 0, mapped_size);
+    header->version = HISTORY_VERSION;
+    header->record_size = sizeof(history_record);
+    header->capacity = capacity;
+    header->head = 0;
+    __atomic_store_n(&header->magic, HISTORY_MAGIC, __ATOMIC_RELEASE);
+}
+
+/* A record is committed once its seq is stored, the cursor may lag behind it after a crash */
+static void history_recover() {
+    uint64_t head = header->head;
+    while (records[head % header->capacity].seq == head + 1)
+        head++;
+    if (head != header->head)
+        syslog(LOG_INFO, "Recovered %llu history records past the cursor", (unsigned long long)(head - header->head));
+    header->head = head;
+}
+
+int history_init(const char* path, unsigned capacity) {
+    if (path == NULL || path[0] == '\0' || capacity == 0)
+        return -1;
+
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        syslog(LOG_WARNING, "Failed to open the history file %s: %s", path, strerror(errno));
+        return -1;
+    }
+
+    size_t size = sizeof(history_header) + (size_t)capacity * sizeof(history_record);
+    struct stat st;
+    if (fstat(fd, &st) != 0 || ((size_t)st.st_size != size && ftruncate(fd, size) != 0)) {
+        syslog(LOG_WARNING, "Failed to size the history file %s: %s", path, strerror(errno));
+        close(fd);
+        return -1;
+    }
+
+    void* map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        syslog(LOG_WARNING, "Failed to map the history file %s: %s", path, strerror(errno));
+        return -1;
+    }
+
+    header = (history_header*) map;
+    records = (history_record*)(header + 1);
+    mapped_size = size;
+    if (!history_valid(capacity)) {
+        if (header->magic == HISTORY_MAGIC)
+            syslog(LOG_INFO, "History file %s has a different layout, starting over", path);
+        history_reset(capacity);
+    } else {
+        history_recover();
+    }
+    return 0;
+}
+
+void history_append(const history_record* record) {
+    if (header == NULL)
+        return;
+
+    uint64_t seq = header->head;
+    history_record* slot = &records[seq % header->capacity];
+    /* invalidate the slot first, a crash in between must not leave the old seq on new data */
+    __atomic_store_n(&slot->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy((char*)slot + sizeof(slot->seq), (const char*)record + sizeof(record->seq),
+        sizeof(history_record) - sizeof(slot->seq));
+    /* seq is stored as seq + 1 so a zeroed slot never looks committed */
+    __atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&header->head, seq + 1, __ATOMIC_RELEASE);
+}
+
+bool history_bounds(uint64_t* first, uint64_t* end) {
+    if (header == NULL)
+        return false;
+
+    *end = header->head;
+    *first = *end > header->capacity ? *end - header->capacity : 0;
+    return true;
+}
+
+const history_record* history_at(uint64_t seq) {
+    if (header == NULL || seq >= header->head || header->head - seq > header->capacity)
+        return NULL;
+
+    const history_record* record = &records[seq % header->capacity];
+    return record->seq == seq + 1 ? record : NULL;
+}
+
+void history_cleanup() {
+    if (header == NULL)
+        return;
+
+    msync(header, mapped_size, MS_SYNC);
+    munmap(header, mapped_size);
+    header = NULL;
+    records = NULL;
+    mapped_size = 0;
+}
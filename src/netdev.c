@@ -0,0 +1,528 @@
+#include "../includes/netdev.h"
+
+static int nl_fd = -1;
+static int ioctl_fd = -1;
+static uint32_t nl_seq = 0;
+static char nl_buf[NETDEV_BUFFER_SIZE] __attribute__((aligned(NLMSG_ALIGNTO)));
+static struct uloop_fd nl_events = { .fd = -1 };
+static netdev_change_cb change_cb = NULL;
+
+/* two tables alternate so rates can be derived from the previous sample, the collector dumps
+ * into the other one while notifications patch the current one on the event loop */
+static network_info tables[2];
+static unsigned capacity[2];
+static uint64_t sampled_at[2];
+static int current = -1;
+static bool collected = false;
+
+typedef struct address_list {
+    net_address* entries;
+    unsigned count;
+    unsigned capacity;
+} address_list;
+
+/* addresses only change through notifications, they are kept outside the tables,
+ * after an overflow the collector dumps them into the other list */
+static address_list address_lists[2];
+static int address_slot = 0;
+static bool resync_requested = false;
+static bool resynced = false;
+
+static bool link_up(int flags) {
+    return (flags & IFF_UP) && (flags & IFF_RUNNING);
+}
+
+static void netdev_notify(const _network* net, int change) {
+    if (change_cb != NULL)
+        change_cb(net, change);
+}
+
+static _network* netdev_append(int slot) {
+    network_info* t = &tables[slot];
+    if (t->interface_count == capacity[slot]) {
+        unsigned grown = capacity[slot] ? capacity[slot] * 2 : 16;
+        _network* interfaces = (_network*) realloc(t->interfaces, grown * sizeof(_network));
+        if (interfaces == NULL) {
+            syslog(LOG_ERR, "Failed to allocate memory for the interface table!");
+            return NULL;
+        }
+        t->interfaces = interfaces;
+        capacity[slot] = grown;
+    }
+
+    _network* net = &t->interfaces[t->interface_count++];
+    memset(net, 0, sizeof(_network));
+    return net;
+}
+
+static _network* netdev_find_index(const network_info* t, int index) {
+    for (unsigned i = 0; i < t->interface_count; i++) {
+        if (t->interfaces[i].ni_index == index)
+            return &t->interfaces[i];
+    }
+    return NULL;
+}
+
+static void netdev_parse_link(_network* net, struct nlmsghdr* nh) {
+    struct ifinfomsg* ifi = (struct ifinfomsg*) NLMSG_DATA(nh);
+    net->ni_index = ifi->ifi_index;
+    net->ni_flags = (int)ifi->ifi_flags;
+
+    bool have_stats64 = false;
+    int len = IFLA_PAYLOAD(nh);
+    for (struct rtattr* rta = IFLA_RTA(ifi); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+        if (rta->rta_type == IFLA_IFNAME) {
+            snprintf(net->ni_name, sizeof(net->ni_name), "%s", (const char*) RTA_DATA(rta));
+        } else if (rta->rta_type == IFLA_STATS64 && RTA_PAYLOAD(rta) >= sizeof(struct rtnl_link_stats64)) {
+            /* attribute payloads are only 4 byte aligned */
+            struct rtnl_link_stats64 st;
+            memcpy(&st, RTA_DATA(rta), sizeof(st));
+            net->stats = (net_counters) {
+                st.rx_bytes, st.tx_bytes, st.rx_packets, st.tx_packets,
+                st.rx_errors, st.tx_errors, st.rx_dropped, st.tx_dropped
+            };
+            have_stats64 = true;
+        } else if (rta->rta_type == IFLA_STATS && !have_stats64
+                && RTA_PAYLOAD(rta) >= sizeof(struct rtnl_link_stats)) {
+            struct rtnl_link_stats st;
+            memcpy(&st, RTA_DATA(rta), sizeof(st));
+            net->stats = (net_counters) {
+                st.rx_bytes, st.tx_bytes, st.rx_packets, st.tx_packets,
+                st.rx_errors, st.tx_errors, st.rx_dropped, st.tx_dropped
+            };
+        }
+    }
+}
+
+static bool netdev_parse_addr(net_address* addr, struct nlmsghdr* nh) {
+    struct ifaddrmsg* ifa = (struct ifaddrmsg*) NLMSG_DATA(nh);
+    if (ifa->ifa_family != AF_INET && ifa->ifa_family != AF_INET6)
+        return false;
+
+    memset(addr, 0, sizeof(net_address));
+    addr->ni_index = (int)ifa->ifa_index;
+    addr->family = ifa->ifa_family;
+    addr->prefix_len = ifa->ifa_prefixlen;
+
+    /* IFA_LOCAL is the local end of point-to-point links, prefer it over IFA_ADDRESS */
+    const void* data = NULL;
+    int len = IFA_PAYLOAD(nh);
+    for (struct rtattr* rta = IFA_RTA(ifa); RTA_OK(rta, len); rta = RTA_NEXT(rta, len)) {
+        if (rta->rta_type == IFA_LOCAL || (rta->rta_type == IFA_ADDRESS && data == NULL))
+            data = RTA_DATA(rta);
+    }
+
+    return data != NULL && inet_ntop(addr->family, data, addr->address, sizeof(addr->address)) != NULL;
+}
+
+static void netdev_link_dump_cb(struct nlmsghdr* nh, int slot) {
+    if (nh->nlmsg_type != RTM_NEWLINK)
+        return;
+
+    _network* net = netdev_append(slot);
+    if (net != NULL)
+        netdev_parse_link(net, nh);
+}
+
+static void netdev_address_add(address_list* list, const net_address* addr) {
+    for (unsigned i = 0; i < list->count; i++) {
+        if (list->entries[i].ni_index == addr->ni_index && strcmp(list->entries[i].address, addr->address) == 0) {
+            list->entries[i].prefix_len = addr->prefix_len;
+            return;
+        }
+    }
+
+    if (list->count == list->capacity) {
+        unsigned grown = list->capacity ? list->capacity * 2 : 16;
+        net_address* array = (net_address*) realloc(list->entries, grown * sizeof(net_address));
+        if (array == NULL) {
+            syslog(LOG_ERR, "Failed to allocate memory for the address table!");
+            return;
+        }
+        list->entries = array;
+        list->capacity = grown;
+    }
+    list->entries[list->count++] = *addr;
+}
+
+static void netdev_address_remove(address_list* list, int index, const char* address) {
+    unsigned kept = 0;
+    for (unsigned i = 0; i < list->count; i++) {
+        if (list->entries[i].ni_index == index && (address == NULL || strcmp(list->entries[i].address, address) == 0))
+            continue;
+        list->entries[kept++] = list->entries[i];
+    }
+    list->count = kept;
+}
+
+static void netdev_addr_dump_cb(struct nlmsghdr* nh, int slot) {
+    net_address addr;
+    if (nh->nlmsg_type == RTM_NEWADDR && netdev_parse_addr(&addr, nh))
+        netdev_address_add(&address_lists[slot], &addr);
+}
+
+static int netdev_dump(int type, size_t payload, void (*cb)(struct nlmsghdr*, int), int slot) {
+    struct {
+        struct nlmsghdr nh;
+        struct ifinfomsg ifi;
+    } req;
+
+    /* ifinfomsg and ifaddrmsg both start with the family, AF_UNSPEC dumps everything */
+    memset(&req, 0, sizeof(req));
+    req.nh.nlmsg_len = NLMSG_LENGTH(payload);
+    req.nh.nlmsg_type = type;
+    req.nh.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    req.nh.nlmsg_seq = ++nl_seq;
+
+    if (send(nl_fd, &req, req.nh.nlmsg_len, 0) < 0)
+        return -1;
+
+    for (;;) {
+        ssize_t n = recv(nl_fd, nl_buf, sizeof(nl_buf), 0);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+
+        int len = (int)n;
+        for (struct nlmsghdr* nh = (struct nlmsghdr*) nl_buf; NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len)) {
+            if (nh->nlmsg_seq != nl_seq)
+                continue;
+            if (nh->nlmsg_type == NLMSG_DONE)
+                return 0;
+            if (nh->nlmsg_type == NLMSG_ERROR)
+                return -1;
+            cb(nh, slot);
+        }
+    }
+}
+
+static int netdev_read_proc(int slot) {
+    const char* data = procfs_read(PROCFS_NET_DEV, NULL);
+    if (data == NULL)
+        return -1;
+
+    /* the first two lines are column headers */
+    const char* line = procfs_next_line(procfs_next_line(data));
+    for (; *line != '\0'; line = procfs_next_line(line)) {
+        while (*line == ' ')
+            line++;
+
+        const char* colon = strchr(line, ':');
+        if (colon == NULL)
+            break;
+
+        _network* net = netdev_append(slot);
+        if (net == NULL)
+            return -1;
+
+        size_t name_len = colon - line;
+        if (name_len >= sizeof(net->ni_name))
+            name_len = sizeof(net->ni_name) - 1;
+        memcpy(net->ni_name, line, name_len);
+        net->ni_name[name_len] = '\0';
+
+        uint64_t col[16];
+        const char* p = colon + 1;
+        for (int i = 0; i < 16; i++)
+            col[i] = procfs_scan_u64(&p);
+        net->stats = (net_counters) {
+            col[0], col[8], col[1], col[9], col[2], col[10], col[3], col[11]
+        };
+
+        struct ifreq ifr;
+        memset(&ifr, 0, sizeof(ifr));
+        memcpy(ifr.ifr_name, net->ni_name, name_len + 1);
+        if (ioctl_fd >= 0 && ioctl(ioctl_fd, SIOCGIFFLAGS, &ifr) == 0)
+            net->ni_flags = ifr.ifr_flags;
+    }
+    return 0;
+}
+
+static const _network* netdev_find(const network_info* t, const _network* net, unsigned hint) {
+    /* interfaces are usually reported in the same order */
+    if (hint < t->interface_count) {
+        const _network* prev = &t->interfaces[hint];
+        if (net->ni_index ? prev->ni_index == net->ni_index : strcmp(prev->ni_name, net->ni_name) == 0)
+            return prev;
+    }
+
+    for (unsigned i = 0; i < t->interface_count; i++) {
+        const _network* prev = &t->interfaces[i];
+        if (net->ni_index ? prev->ni_index == net->ni_index : strcmp(prev->ni_name, net->ni_name) == 0)
+            return prev;
+    }
+    return NULL;
+}
+
+static double netdev_rate(uint64_t cur, uint64_t prev, uint64_t elapsed) {
+    if (cur < prev || elapsed == 0)
+        return 0.0;
+    return (double)(cur - prev) * 8000.0 / (double)elapsed;
+}
+
+/* Runs on the collector thread, it only touches the table and address list not in use */
+static void netdev_collect() {
+    int next = current == 0 ? 1 : 0;
+    collected = false;
+    tables[next].interface_count = 0;
+
+    int rc = nl_fd >= 0 ? netdev_dump(RTM_GETLINK, sizeof(struct ifinfomsg), netdev_link_dump_cb, next) : -1;
+    if (rc != 0) {
+        tables[next].interface_count = 0;
+        rc = netdev_read_proc(next);
+    }
+    if (rc != 0) {
+        syslog(LOG_WARNING, "Failed to sample the network interfaces");
+        return;
+    }
+    sampled_at[next] = get_monotonic_ms();
+    collected = true;
+
+    if (nl_fd >= 0 && __atomic_exchange_n(&resync_requested, false, __ATOMIC_ACQ_REL)) {
+        address_lists[!address_slot].count = 0;
+        resynced = netdev_dump(RTM_GETADDR, sizeof(struct ifaddrmsg), netdev_addr_dump_cb, !address_slot) == 0;
+        if (!resynced)
+            __atomic_store_n(&resync_requested, true, __ATOMIC_RELEASE);
+    }
+}
+
+/* Patches that landed on the current table after the dump are superseded by it, the next sample catches up */
+static void netdev_publish() {
+    if (resynced)
+        address_slot = !address_slot;
+    resynced = false;
+    if (!collected)
+        return;
+
+    int next = current == 0 ? 1 : 0;
+    int prev_table = current;
+    current = next;
+    collected = false;
+    if (prev_table < 0)
+        return;
+
+    /* notifications normally report link changes, this catches the ones that were lost */
+    uint64_t elapsed = sampled_at[next] - sampled_at[prev_table];
+    for (unsigned i = 0; i < tables[next].interface_count; i++) {
+        _network* net = &tables[next].interfaces[i];
+        const _network* prev = netdev_find(&tables[prev_table], net, i);
+        if (prev == NULL) {
+            netdev_notify(net, link_up(net->ni_flags) ? NETDEV_LINK_UP : NETDEV_CHANGED);
+            continue;
+        }
+
+        net->rx_bps = netdev_rate(net->stats.rx_bytes, prev->stats.rx_bytes, elapsed);
+        net->tx_bps = netdev_rate(net->stats.tx_bytes, prev->stats.tx_bytes, elapsed);
+        if (link_up(net->ni_flags) != link_up(prev->ni_flags))
+            netdev_notify(net, link_up(net->ni_flags) ? NETDEV_LINK_UP : NETDEV_LINK_DOWN);
+    }
+}
+
+void netdev_sample() {
+    netdev_collect();
+    netdev_publish();
+}
+
+static void netdev_link_update(struct nlmsghdr* nh) {
+    _network parsed;
+    memset(&parsed, 0, sizeof(parsed));
+    netdev_parse_link(&parsed, nh);
+
+    _network* net = netdev_find_index(&tables[current], parsed.ni_index);
+    if (net == NULL) {
+        net = netdev_append(current);
+        if (net == NULL)
+            return;
+        *net = parsed;
+        netdev_notify(net, link_up(net->ni_flags) ? NETDEV_LINK_UP : NETDEV_CHANGED);
+        return;
+    }
+
+    /* counters are left to the sampler, rates are derived from its timestamps */
+    bool was_up = link_up(net->ni_flags);
+    memcpy(net->ni_name, parsed.ni_name, sizeof(net->ni_name));
+    net->ni_flags = parsed.ni_flags;
+    if (was_up != link_up(net->ni_flags))
+        netdev_notify(net, was_up ? NETDEV_LINK_DOWN : NETDEV_LINK_UP);
+    else
+        netdev_notify(net, NETDEV_CHANGED);
+}
+
+static void netdev_link_remove(struct nlmsghdr* nh) {
+    struct ifinfomsg* ifi = (struct ifinfomsg*) NLMSG_DATA(nh);
+    network_info* t = &tables[current];
+    _network* net = netdev_find_index(t, ifi->ifi_index);
+    if (net == NULL)
+        return;
+
+    _network removed = *net;
+    unsigned i = net - t->interfaces;
+    memmove(net, net + 1, (t->interface_count - i - 1) * sizeof(_network));
+    t->interface_count--;
+
+    netdev_address_remove(&address_lists[address_slot], removed.ni_index, NULL);
+    netdev_notify(&removed, NETDEV_REMOVED);
+}
+
+static void netdev_address_update(struct nlmsghdr* nh) {
+    net_address addr;
+    if (!netdev_parse_addr(&addr, nh))
+        return;
+
+    if (nh->nlmsg_type == RTM_NEWADDR)
+        netdev_address_add(&address_lists[address_slot], &addr);
+    else
+        netdev_address_remove(&address_lists[address_slot], addr.ni_index, addr.address);
+
+    const _network* net = netdev_find_index(&tables[current], addr.ni_index);
+    if (net != NULL)
+        netdev_notify(net, NETDEV_CHANGED);
+}
+
+/* Notifications were dropped, the collector rebuilds everything from fresh dumps on its next tick */
+static void netdev_resync() {
+    syslog(LOG_NOTICE, "rtnetlink notifications overflowed, resynchronising interfaces");
+    __atomic_store_n(&resync_requested, true, __ATOMIC_RELEASE);
+}
+
+static void netdev_events_cb(struct uloop_fd* u, unsigned int events) {
+    for (;;) {
+        ssize_t n = recv(u->fd, nl_buf, sizeof(nl_buf), MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == ENOBUFS) {
+                netdev_resync();
+                continue;
+            }
+            return;
+        }
+
+        /* until the first sample there is no table to patch */
+        if (current < 0)
+            continue;
+
+        int len = (int)n;
+        for (struct nlmsghdr* nh = (struct nlmsghdr*) nl_buf; NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len)) {
+            switch (nh->nlmsg_type) {
+                case RTM_NEWLINK:
+                    netdev_link_update(nh);
+                    break;
+                case RTM_DELLINK:
+                    netdev_link_remove(nh);
+                    break;
+                case RTM_NEWADDR:
+                case RTM_DELADDR:
+                    netdev_address_update(nh);
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+}
+
+static int netdev_subscribe() {
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_ROUTE);
+    if (fd < 0)
+        return -1;
+
+    int rcvbuf = 256 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    struct sockaddr_nl addr = {
+        .nl_family = AF_NETLINK,
+        .nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR,
+    };
+    if (bind(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    nl_events.fd = fd;
+    nl_events.cb = netdev_events_cb;
+    uloop_fd_add(&nl_events, ULOOP_READ);
+    return 0;
+}
+
+static sampler_hook netdev_hook = { .name = "netdev", .collect = netdev_collect, .cb = netdev_publish };
+
+int netdev_init() {
+    sampler_add(&netdev_hook);
+    ioctl_fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+
+    /* rtnetlink only describes the interfaces of the live system, not those of another procfs root */
+    if (strcmp(procfs_root(), "/proc") != 0) {
+        syslog(LOG_INFO, "Reading the interfaces from %s/net/dev", procfs_root());
+        return -1;
+    }
+
+    nl_fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (nl_fd < 0) {
+        syslog(LOG_WARNING, "Failed to open rtnetlink socket, falling back to /proc/net/dev");
+        return -1;
+    }
+
+    struct timeval timeout = { .tv_sec = 1 };
+    setsockopt(nl_fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    struct sockaddr_nl addr = { .nl_family = AF_NETLINK };
+    if (bind(nl_fd, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+        syslog(LOG_WARNING, "Failed to bind rtnetlink socket, falling back to /proc/net/dev");
+        close(nl_fd);
+        nl_fd = -1;
+        return -1;
+    }
+
+    /* subscribe before dumping so no change falls in between */
+    if (netdev_subscribe() != 0)
+        syslog(LOG_WARNING, "Failed to subscribe to rtnetlink notifications, interfaces are only sampled");
+
+    if (netdev_dump(RTM_GETADDR, sizeof(struct ifaddrmsg), netdev_addr_dump_cb, 0) != 0)
+        syslog(LOG_WARNING, "Failed to dump interface addresses");
+    return 0;
+}
+
+void netdev_set_change_cb(netdev_change_cb cb) {
+    change_cb = cb;
+}
+
+const network_info* get_netdev_table() {
+    if (current < 0)
+        return NULL;
+
+    tables[current].addresses = address_lists[address_slot].entries;
+    tables[current].address_count = address_lists[address_slot].count;
+    return &tables[current];
+}
+
+void netdev_cleanup() {
+    if (nl_events.fd >= 0) {
+        uloop_fd_delete(&nl_events);
+        close(nl_events.fd);
+        nl_events.fd = -1;
+    }
+    if (nl_fd >= 0)
+        close(nl_fd);
+    if (ioctl_fd >= 0)
+        close(ioctl_fd);
+    nl_fd = ioctl_fd = -1;
+
+    for (int i = 0; i < 2; i++) {
+        free(tables[i].interfaces);
+        memset(&tables[i], 0, sizeof(network_info));
+        capacity[i] = 0;
+    }
+    current = -1;
+    collected = false;
+
+    for (int i = 0; i < 2; i++) {
+        free(address_lists[i].entries);
+        memset(&address_lists[i], 0, sizeof(address_list));
+    }
+    address_slot = 0;
+    resync_requested = resynced = false;
+    change_cb = NULL;
+}
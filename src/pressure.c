@@ -0,0 +1,133 @@
+#include "../includes/pressure.h"
+
+static const char* names[__PRESSURE_MAX] = {
+    [PRESSURE_CPU] = "cpu",
+    [PRESSURE_MEMORY] = "memory",
+    [PRESSURE_IO] = "io",
+};
+
+static const int files[__PRESSURE_MAX] = {
+    [PRESSURE_CPU] = PROCFS_PRESSURE_CPU,
+    [PRESSURE_MEMORY] = PROCFS_PRESSURE_MEMORY,
+    [PRESSURE_IO] = PROCFS_PRESSURE_IO,
+};
+
+static bool supported = false;
+static int trigger_fds[__PRESSURE_MAX] = { -1, -1, -1 };
+static pressure_stall_cb stall_cb = NULL;
+
+/* uloop only asks epoll for readability, triggers signal POLLPRI, so each trigger sits in
+ * an epoll set of its own which becomes readable whenever it fires. Polling a trigger clears
+ * its event, so the poll uloop does on the set already consumes it: readability of the set
+ * is the stall, an epoll_wait on it afterwards would find nothing. */
+static struct uloop_fd psi_events[__PRESSURE_MAX] = {
+    [PRESSURE_CPU] = { .fd = -1 },
+    [PRESSURE_MEMORY] = { .fd = -1 },
+    [PRESSURE_IO] = { .fd = -1 },
+};
+
+static void pressure_events_cb(struct uloop_fd* u, unsigned int events) {
+    if (stall_cb != NULL)
+        stall_cb((int)(u - psi_events));
+}
+
+static int pressure_trigger(int resource) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/pressure/%s", procfs_root(), names[resource]);
+    int fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+
+    int set = epoll_create1(EPOLL_CLOEXEC);
+    if (set < 0) {
+        syslog(LOG_WARNING, "Failed to create the epoll set for the %s PSI trigger", names[resource]);
+        close(fd);
+        return -1;
+    }
+
+    char trigger[64];
+    int len = snprintf(trigger, sizeof(trigger), "some %d %d", PSI_TRIGGER_STALL, PSI_TRIGGER_WINDOW);
+    /* the kernel expects the terminating NUL as part of the write */
+    struct epoll_event ev = { .events = EPOLLPRI };
+    if (write(fd, trigger, len + 1) < 0 || epoll_ctl(set, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        syslog(LOG_WARNING, "Failed to register a PSI trigger on %s: %s", path, strerror(errno));
+        close(set);
+        close(fd);
+        return -1;
+    }
+
+    trigger_fds[resource] = fd;
+    psi_events[resource].fd = set;
+    psi_events[resource].cb = pressure_events_cb;
+    uloop_fd_add(&psi_events[resource], ULOOP_READ);
+    return 0;
+}
+
+int pressure_init() {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/pressure", procfs_root());
+    supported = access(path, F_OK) == 0;
+    if (!supported) {
+        syslog(LOG_WARNING, "PSI is not available, pressure will not be reported");
+        return -1;
+    }
+
+    unsigned registered = 0;
+    for (int i = 0; i < __PRESSURE_MAX; i++)
+        registered += pressure_trigger(i) == 0;
+    return registered > 0 ? 0 : -1;
+}
+
+void pressure_set_stall_cb(pressure_stall_cb cb) {
+    stall_cb = cb;
+}
+
+/* "some avg10=0.00 avg60=0.00 avg300=0.00 total=0" */
+static bool pressure_parse(const char* line, pressure_avg* avg) {
+    return sscanf(line, "%*s avg10=%lf avg60=%lf avg300=%lf total=%" SCNu64,
+        &avg->avg10, &avg->avg60, &avg->avg300, &avg->total) == 4;
+}
+
+bool get_pressure(int resource, pressure_info* info) {
+    if (!supported || resource < 0 || resource >= __PRESSURE_MAX)
+        return false;
+
+    const char* data = procfs_read(files[resource], NULL);
+    if (data == NULL)
+        return false;
+
+    memset(info, 0, sizeof(pressure_info));
+    bool has_some = false;
+    for (const char* line = data; *line != '\0'; line = procfs_next_line(line)) {
+        if (strncmp(line, "some ", 5) == 0)
+            has_some = pressure_parse(line, &info->some);
+        else if (strncmp(line, "full ", 5) == 0)
+            info->has_full = pressure_parse(line, &info->full);
+    }
+    return has_some;
+}
+
+const char* pressure_name(int resource) {
+    if (resource < 0 || resource >= __PRESSURE_MAX)
+        return NULL;
+    return names[resource];
+}
+
+bool pressure_triggered(int resource) {
+    return resource >= 0 && resource < __PRESSURE_MAX && trigger_fds[resource] >= 0;
+}
+
+void pressure_cleanup() {
+    /* closing the descriptor destroys its trigger */
+    for (int i = 0; i < __PRESSURE_MAX; i++) {
+        if (psi_events[i].fd >= 0) {
+            uloop_fd_delete(&psi_events[i]);
+            close(psi_events[i].fd);
+            psi_events[i].fd = -1;
+        }
+        if (trigger_fds[i] >= 0)
+            close(trigger_fds[i]);
+        trigger_fds[i] = -1;
+    }
+    supported = false;
+}
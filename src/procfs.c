@@ -0,0 +1,187 @@
+#include "../includes/procfs.h"
+
+typedef struct procfs_file {
+    const char* name;
+    int fd;
+    char* buf;
+    size_t size;
+} procfs_file;
+
+static procfs_file files[__PROCFS_MAX] = {
+    [PROCFS_MEMINFO] = { .name = "meminfo", .fd = -1 },
+    [PROCFS_UPTIME] = { .name = "uptime", .fd = -1 },
+    [PROCFS_STAT] = { .name = "stat", .fd = -1 },
+    [PROCFS_CPUINFO] = { .name = "cpuinfo", .fd = -1 },
+    [PROCFS_LOADAVG] = { .name = "loadavg", .fd = -1 },
+    [PROCFS_NET_DEV] = { .name = "net/dev", .fd = -1 },
+    [PROCFS_DISKSTATS] = { .name = "diskstats", .fd = -1 },
+    [PROCFS_MOUNTINFO] = { .name = "self/mountinfo", .fd = -1 },
+    [PROCFS_PRESSURE_CPU] = { .name = "pressure/cpu", .fd = -1 },
+    [PROCFS_PRESSURE_MEMORY] = { .name = "pressure/memory", .fd = -1 },
+    [PROCFS_PRESSURE_IO] = { .name = "pressure/io", .fd = -1 },
+};
+
+static char root[PATH_MAX] = "/proc";
+
+int procfs_init(const char* path) {
+    if (path != NULL)
+        snprintf(root, sizeof(root), "%s", path);
+
+    for (int i = 0; i < __PROCFS_MAX; i++) {
+        if (files[i].buf != NULL)
+            continue;
+
+        files[i].buf = (char*) malloc(PROCFS_BUFFER_SIZE);
+        if (files[i].buf == NULL) {
+            syslog(LOG_CRIT, "Failed to allocate memory for procfs buffers!");
+            procfs_cleanup();
+            return -1;
+        }
+        files[i].size = PROCFS_BUFFER_SIZE;
+    }
+    return 0;
+}
+
+const char* procfs_root() {
+    return root;
+}
+
+static int procfs_open(procfs_file* f) {
+    if (f->fd < 0) {
+        char path[sizeof(root) + 16];
+        snprintf(path, sizeof(path), "%s/%s", root, f->name);
+        f->fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (f->fd < 0)
+            syslog(LOG_WARNING, "Failed to open %s", path);
+    }
+    return f->fd;
+}
+
+int procfs_fd(int file) {
+    if (file < 0 || file >= __PROCFS_MAX || files[file].buf == NULL)
+        return -1;
+    return procfs_open(&files[file]);
+}
+
+const char* procfs_read(int file, size_t* len) {
+    if (file < 0 || file >= __PROCFS_MAX || files[file].buf == NULL)
+        return NULL;
+
+    procfs_file* f = &files[file];
+    if (procfs_open(f) < 0)
+        return NULL;
+
+    /* seq_file backed entries return at most about a page per read, whatever the buffer size,
+     * so only a read returning 0 marks the end of the file. A failure to grow the buffer
+     * fails the whole read, callers never see a truncated file. */
+    size_t total = 0;
+    for (;;) {
+        if (total == f->size - 1) {
+            char* grown = (char*) realloc(f->buf, f->size * 2);
+            if (grown == NULL) {
+                syslog(LOG_ERR, "Failed to grow the buffer for %s/%s", root, f->name);
+                return NULL;
+            }
+            f->buf = grown;
+            f->size *= 2;
+        }
+
+        ssize_t n = pread(f->fd, f->buf + total, f->size - total - 1, total);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            syslog(LOG_WARNING, "Failed to read %s/%s", root, f->name);
+            return NULL;
+        }
+        if (n == 0)
+            break;
+        total += n;
+    }
+
+    f->buf[total] = '\0';
+    if (len != NULL)
+        *len = total;
+    return f->buf;
+}
+
+ssize_t procfs_read_pid(int pid, const char* name, char* buf, size_t size) {
+    if (size == 0)
+        return -1;
+
+    char path[sizeof(root) + 64];
+    snprintf(path, sizeof(path), "%s/%d/%s", root, pid, name);
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+
+    ssize_t n;
+    do {
+        n = read(fd, buf, size - 1);
+    } while (n < 0 && errno == EINTR);
+    close(fd);
+
+    if (n < 0)
+        return -1;
+
+    buf[n] = '\0';
+    return n;
+}
+
+void procfs_cleanup() {
+    for (int i = 0; i < __PROCFS_MAX; i++) {
+        if (files[i].fd >= 0)
+            close(files[i].fd);
+        free(files[i].buf);
+        files[i].fd = -1;
+        files[i].buf = NULL;
+        files[i].size = 0;
+    }
+}
+
+const char* procfs_next_line(const char* p) {
+    while (*p != '\0' && *p != '\n')
+        p++;
+    return *p == '\n' ? p + 1 : p;
+}
+
+uint64_t procfs_scan_u64(const char** p) {
+    const char* c = *p;
+    while (*c == ' ' || *c == '\t')
+        c++;
+
+    uint64_t value = 0;
+    while (*c >= '0' && *c <= '9')
+        value = value * 10 + (uint64_t)(*c++ - '0');
+
+    *p = c;
+    return value;
+}
+
+const char* procfs_field(const char* line, const char* key) {
+    while (*key != '\0') {
+        if (*line++ != *key++)
+            return NULL;
+    }
+
+    while (*line == ' ' || *line == '\t')
+        line++;
+    if (*line != ':')
+        return NULL;
+
+    line++;
+    while (*line == ' ' || *line == '\t')
+        line++;
+    return line;
+}
+
+void procfs_copy_value(char* dst, size_t size, const char* value) {
+    if (size == 0)
+        return;
+
+    size_t i = 0;
+    while (i < size - 1 && value[i] != '\0' && value[i] != '\n') {
+        dst[i] = value[i];
+        i++;
+    }
+    dst[i] = '\0';
+}
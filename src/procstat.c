@@ -0,0 +1,354 @@
+#include "../includes/procstat.h"
+
+/* Last seen counters of a process, the start time tells a reused pid apart */
+typedef struct procstat_entry {
+    unsigned pid;
+    unsigned generation;
+    uint64_t start_time;
+    uint64_t ticks;
+    uint64_t ticks_seen;
+    uint64_t io_bytes;
+    uint64_t io_seen;
+} procstat_entry;
+
+/* The record layout getdents64 fills the buffer with */
+struct linux_dirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+/* Open addressing table keyed by pid, `slots` is a power of two */
+static procstat_entry* entries = NULL;
+static unsigned slots = 0;
+static unsigned used = 0;
+static unsigned generation = 0;
+
+static int proc_dir = -1;
+static char dents[PROCSTAT_DENTS_SIZE];
+
+/* CLOCK_BOOTTIME shares its origin with the start time in /proc/<pid>/stat */
+static uint64_t boottime_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_BOOTTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static unsigned procstat_slot(unsigned pid, unsigned size) {
+    return (pid * 2654435761u) & (size - 1);
+}
+
+static bool procstat_keep(const procstat_entry* e, uint64_t now, bool scanned) {
+    if (e->pid == 0)
+        return false;
+    if (scanned)
+        return e->generation == generation;
+
+    uint64_t seen = e->ticks_seen > e->io_seen ? e->ticks_seen : e->io_seen;
+    return e->generation == generation || now - seen < (uint64_t)PROCSTAT_EXPIRE * 1000000;
+}
+
+/* Rebuilds the table, dropping processes that vanished or were not looked at for a while */
+static bool procstat_rehash(uint64_t now, bool scanned) {
+    unsigned kept = 0;
+    for (unsigned i = 0; i < slots; i++) {
+        if (procstat_keep(&entries[i], now, scanned))
+            kept++;
+    }
+
+    unsigned size = PROCSTAT_MIN_SLOTS;
+    while (size < (kept + 1) * 4)
+        size *= 2;
+
+    procstat_entry* table = (procstat_entry*) calloc(size, sizeof(procstat_entry));
+    if (table == NULL) {
+        syslog(LOG_WARNING, "Failed to allocate the process history!");
+        return false;
+    }
+
+    for (unsigned i = 0; i < slots; i++) {
+        if (!procstat_keep(&entries[i], now, scanned))
+            continue;
+
+        unsigned slot = procstat_slot(entries[i].pid, size);
+        while (table[slot].pid != 0)
+            slot = (slot + 1) & (size - 1);
+        table[slot] = entries[i];
+    }
+
+    free(entries);
+    entries = table;
+    slots = size;
+    used = kept;
+    return true;
+}
+
+static procstat_entry* procstat_entry_get(const process* proc, uint64_t now) {
+    if ((used + 1) * 2 > slots && !procstat_rehash(now, false))
+        return NULL;
+
+    unsigned slot = procstat_slot(proc->pid, slots);
+    while (entries[slot].pid != 0 && entries[slot].pid != proc->pid)
+        slot = (slot + 1) & (slots - 1);
+
+    procstat_entry* e = &entries[slot];
+    if (e->pid == 0)
+        used++;
+    if (e->pid != proc->pid || e->start_time != proc->start_time) {
+        memset(e, 0, sizeof(procstat_entry));
+        e->pid = proc->pid;
+        e->start_time = proc->start_time;
+    }
+    e->generation = generation;
+    return e;
+}
+
+/* Per second rate of a counter since it was last seen, or since the process was started */
+static double procstat_rate(uint64_t value, uint64_t* last, uint64_t* seen, uint64_t now, uint64_t started) {
+    uint64_t delta = value;
+    uint64_t since = now > started ? now - started : 0;
+    if (*seen != 0 && now > *seen && value >= *last) {
+        delta = value - *last;
+        since = now - *seen;
+    }
+
+    *last = value;
+    *seen = now;
+    return since > 0 ? delta / (since / 1e9) : 0;
+}
+
+static double procstat_cpu_rate(procstat_entry* e, const process* proc, uint64_t now, uint64_t hz) {
+    uint64_t ticks = proc->utime + proc->stime;
+    uint64_t started = proc->start_time * 1000000000 / hz;
+    if (e == NULL)
+        return now > started ? 100.0 * ((double)ticks / hz) / ((now - started) / 1e9) : 0;
+    return 100.0 * procstat_rate(ticks, &e->ticks, &e->ticks_seen, now, started) / hz;
+}
+
+double procstat_cpu_percent(const process* proc) {
+    uint64_t now = boottime_ns();
+    return procstat_cpu_rate(procstat_entry_get(proc, now), proc, now, (uint64_t)sysconf(_SC_CLK_TCK));
+}
+
+static void procstat_io_parse(const char* data, process_io* io) {
+    memset(io, 0, sizeof(process_io));
+    const char* value;
+    for (const char* line = data; *line != '\0'; line = procfs_next_line(line)) {
+        if ((value = procfs_field(line, "rchar")) != NULL)
+            io->rchar = procfs_scan_u64(&value);
+        else if ((value = procfs_field(line, "wchar")) != NULL)
+            io->wchar = procfs_scan_u64(&value);
+        else if ((value = procfs_field(line, "read_bytes")) != NULL)
+            io->read_bytes = procfs_scan_u64(&value);
+        else if ((value = procfs_field(line, "write_bytes")) != NULL)
+            io->write_bytes = procfs_scan_u64(&value);
+        else if ((value = procfs_field(line, "cancelled_write_bytes")) != NULL)
+            io->cancelled_write_bytes = procfs_scan_u64(&value);
+    }
+}
+
+/* Reads a per-process file relative to the procfs directory, saving the path walk from the root */
+static ssize_t procstat_read_at(const char* name, char* buf, size_t size) {
+    int fd = openat(proc_dir, name, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return -1;
+
+    ssize_t n;
+    do {
+        n = read(fd, buf, size - 1);
+    } while (n < 0 && errno == EINTR);
+    close(fd);
+
+    if (n < 0)
+        return -1;
+    buf[n] = '\0';
+    return n;
+}
+
+static double procstat_key(const process_top* t, int by) {
+    switch (by) {
+        case PROCSTAT_BY_RSS:
+            return (double)t->proc.rss;
+        case PROCSTAT_BY_IO:
+            return t->io_rate;
+        default:
+            return t->cpu_percent;
+    }
+}
+
+/* Restores the min-heap property below index i, the smallest key stays at the root */
+static void procstat_sift_down(process_top* heap, unsigned n, unsigned i, int by) {
+    for (;;) {
+        unsigned smallest = i, l = 2 * i + 1, r = 2 * i + 2;
+        if (l < n && procstat_key(&heap[l], by) < procstat_key(&heap[smallest], by))
+            smallest = l;
+        if (r < n && procstat_key(&heap[r], by) < procstat_key(&heap[smallest], by))
+            smallest = r;
+        if (smallest == i)
+            return;
+
+        process_top tmp = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = tmp;
+        i = smallest;
+    }
+}
+
+static void procstat_sift_up(process_top* heap, unsigned i, int by) {
+    while (i > 0) {
+        unsigned parent = (i - 1) / 2;
+        if (procstat_key(&heap[parent], by) <= procstat_key(&heap[i], by))
+            return;
+
+        process_top tmp = heap[i];
+        heap[i] = heap[parent];
+        heap[parent] = tmp;
+        i = parent;
+    }
+}
+
+unsigned procstat_scan(procstat_scan_cb cb, void* priv) {
+    if (proc_dir < 0) {
+        proc_dir = open(procfs_root(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (proc_dir < 0) {
+            syslog(LOG_ERR, "Failed to open %s for the process scan!", procfs_root());
+            return 0;
+        }
+    } else if (lseek(proc_dir, 0, SEEK_SET) < 0) {
+        return 0;
+    }
+
+    unsigned seen = 0;
+    process proc;
+    char buffer[1024];
+    long len;
+    while ((len = syscall(SYS_getdents64, proc_dir, dents, sizeof(dents))) > 0) {
+        for (long off = 0; off < len; ) {
+            const struct linux_dirent64* d = (const struct linux_dirent64*)(dents + off);
+            off += d->d_reclen;
+            if (d->d_name[0] < '1' || d->d_name[0] > '9')
+                continue;
+
+            const char* p = d->d_name;
+            int pid = (int)procfs_scan_u64(&p);
+            if (*p != '\0')
+                continue;
+
+            char path[32];
+            snprintf(path, sizeof(path), "%d/stat", pid);
+            if (procstat_read_at(path, buffer, sizeof(buffer)) < 0 || !pid_stat_parse(pid, buffer, &proc))
+                continue;
+
+            cb(&proc, priv);
+            seen++;
+        }
+    }
+    return seen;
+}
+
+/* State of a top scan, `heap` holds `n` of at most `count` processes with the smallest key at the root */
+typedef struct procstat_top_ctx {
+    int by;
+    unsigned count;
+    unsigned n;
+    process_top* heap;
+    uint64_t hz;
+} procstat_top_ctx;
+
+static void procstat_top_cb(const process* proc, void* priv) {
+    procstat_top_ctx* ctx = (procstat_top_ctx*) priv;
+    process_top cur = { .proc = *proc };
+
+    uint64_t now = boottime_ns();
+    procstat_entry* e = procstat_entry_get(proc, now);
+    cur.cpu_percent = procstat_cpu_rate(e, proc, now, ctx->hz);
+    if (ctx->by == PROCSTAT_BY_IO && e != NULL) {
+        char path[32], buffer[512];
+        snprintf(path, sizeof(path), "%u/io", proc->pid);
+        if (procstat_read_at(path, buffer, sizeof(buffer)) >= 0) {
+            process_io io;
+            procstat_io_parse(buffer, &io);
+            uint64_t started = proc->start_time * 1000000000 / ctx->hz;
+            cur.io_rate = procstat_rate(io.read_bytes + io.write_bytes, &e->io_bytes, &e->io_seen, now, started);
+        }
+    }
+
+    if (ctx->n < ctx->count) {
+        ctx->heap[ctx->n] = cur;
+        procstat_sift_up(ctx->heap, ctx->n++, ctx->by);
+    } else if (procstat_key(&cur, ctx->by) > procstat_key(&ctx->heap[0], ctx->by)) {
+        ctx->heap[0] = cur;
+        procstat_sift_down(ctx->heap, ctx->n, 0, ctx->by);
+    }
+}
+
+unsigned procstat_top(int by, unsigned count, process_top* top) {
+    if (count > PROCSTAT_TOP_MAX)
+        count = PROCSTAT_TOP_MAX;
+    if (count == 0)
+        return 0;
+
+    generation++;
+    procstat_top_ctx ctx = { .by = by, .count = count, .n = 0, .heap = top, .hz = (uint64_t)sysconf(_SC_CLK_TCK) };
+    unsigned seen = procstat_scan(procstat_top_cb, &ctx);
+
+    /* every live process was just seen, drop the history of the ones that exited */
+    if (seen > 0 && used > seen && used - seen > seen / 4)
+        procstat_rehash(boottime_ns(), true);
+
+    /* heapsort, popping the smallest key to the end leaves the array in descending order */
+    for (unsigned i = ctx.n; i > 1; i--) {
+        process_top tmp = top[0];
+        top[0] = top[i - 1];
+        top[i - 1] = tmp;
+        procstat_sift_down(top, i - 1, 0, by);
+    }
+    return ctx.n;
+}
+
+unsigned procstat_started(const process* proc) {
+    uint64_t hz = (uint64_t)sysconf(_SC_CLK_TCK);
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    uint64_t boot = (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec - boottime_ns();
+    return (unsigned)((boot + proc->start_time * 1000000000 / hz) / 1000000000);
+}
+
+int procstat_fd_count(int pid) {
+    char path[PATH_MAX + 32];
+    snprintf(path, sizeof(path), "%s/%d/fd", procfs_root(), pid);
+    DIR* dir = opendir(path);
+    if (dir == NULL)
+        return -1;
+
+    int count = 0;
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] != '.')
+            count++;
+    }
+    closedir(dir);
+    return count;
+}
+
+bool procstat_io(int pid, process_io* io) {
+    char buffer[512];
+    if (procfs_read_pid(pid, "io", buffer, sizeof(buffer)) < 0)
+        return false;
+
+    procstat_io_parse(buffer, io);
+    return true;
+}
+
+void procstat_cleanup() {
+    free(entries);
+    entries = NULL;
+    slots = 0;
+    used = 0;
+    if (proc_dir >= 0) {
+        close(proc_dir);
+        proc_dir = -1;
+    }
+}
@@ -0,0 +1,379 @@
+#include "../includes/ptree.h"
+
+/* Marks a slot whose process was removed, probing continues past it */
+#define PTREE_TOMBSTONE     UINT32_MAX
+
+/* Children of a process form a doubly linked list through the sibling pids, `parent` owns the list,
+ * `leader_exited` marks a process whose leader thread exited while other threads kept running */
+typedef struct ptree_node {
+    unsigned pid;
+    unsigned parent;
+    unsigned first_child;
+    unsigned next_sibling;
+    unsigned prev_sibling;
+    bool leader_exited;
+} ptree_node;
+
+/* Open addressing table keyed by pid, `slots` is a power of two */
+static ptree_node* nodes = NULL;
+static unsigned slots = 0;
+static unsigned used = 0;
+static unsigned live = 0;
+/* Children of the virtual process 0 */
+static unsigned roots = 0;
+static bool stale = true;
+
+static char cn_buf[PTREE_BUFFER_SIZE] __attribute__((aligned(NLMSG_ALIGNTO)));
+static struct uloop_fd cn_events = { .fd = -1 };
+
+static unsigned ptree_slot(unsigned pid, unsigned size) {
+    return (pid * 2654435761u) & (size - 1);
+}
+
+static ptree_node* ptree_find(unsigned pid) {
+    if (pid == 0 || slots == 0)
+        return NULL;
+
+    for (unsigned slot = ptree_slot(pid, slots); nodes[slot].pid != 0; slot = (slot + 1) & (slots - 1)) {
+        if (nodes[slot].pid == pid)
+            return &nodes[slot];
+    }
+    return NULL;
+}
+
+/* Rebuilds the table without tombstones, growing it if it is getting full */
+static bool ptree_rehash() {
+    unsigned size = PTREE_MIN_SLOTS;
+    while (size < (live + 1) * 4)
+        size *= 2;
+
+    ptree_node* table = (ptree_node*) calloc(size, sizeof(ptree_node));
+    if (table == NULL) {
+        syslog(LOG_WARNING, "Failed to allocate the process index!");
+        return false;
+    }
+
+    for (unsigned i = 0; i < slots; i++) {
+        if (nodes[i].pid == 0 || nodes[i].pid == PTREE_TOMBSTONE)
+            continue;
+
+        unsigned slot = ptree_slot(nodes[i].pid, size);
+        while (table[slot].pid != 0)
+            slot = (slot + 1) & (size - 1);
+        table[slot] = nodes[i];
+    }
+
+    free(nodes);
+    nodes = table;
+    slots = size;
+    used = live;
+    return true;
+}
+
+static ptree_node* ptree_insert(unsigned pid) {
+    if ((used + 1) * 2 > slots && !ptree_rehash())
+        return NULL;
+
+    unsigned slot = ptree_slot(pid, slots);
+    while (nodes[slot].pid != 0 && nodes[slot].pid != PTREE_TOMBSTONE)
+        slot = (slot + 1) & (slots - 1);
+
+    if (nodes[slot].pid == 0)
+        used++;
+    live++;
+    memset(&nodes[slot], 0, sizeof(ptree_node));
+    nodes[slot].pid = pid;
+    return &nodes[slot];
+}
+
+static void ptree_remove(ptree_node* node) {
+    node->pid = PTREE_TOMBSTONE;
+    live--;
+}
+
+/* Processes whose parent is not indexed hang off the virtual process 0 */
+static unsigned* ptree_children(unsigned parent) {
+    ptree_node* p = ptree_find(parent);
+    return p != NULL ? &p->first_child : &roots;
+}
+
+static void ptree_link(ptree_node* node, unsigned ppid) {
+    node->parent = ptree_find(ppid) != NULL ? ppid : 0;
+    unsigned* first = ptree_children(node->parent);
+    node->prev_sibling = 0;
+    node->next_sibling = *first;
+    ptree_node* next = ptree_find(*first);
+    if (next != NULL)
+        next->prev_sibling = node->pid;
+    *first = node->pid;
+}
+
+static void ptree_unlink(ptree_node* node) {
+    ptree_node* prev = ptree_find(node->prev_sibling);
+    ptree_node* next = ptree_find(node->next_sibling);
+    if (prev != NULL)
+        prev->next_sibling = node->next_sibling;
+    else
+        *ptree_children(node->parent) = node->next_sibling;
+    if (next != NULL)
+        next->prev_sibling = node->prev_sibling;
+    node->prev_sibling = node->next_sibling = 0;
+}
+
+/* A process found by the scan, `leader_exited` as in `ptree_node` */
+typedef struct ptree_scan_entry {
+    unsigned pid;
+    unsigned ppid;
+    bool leader_exited;
+} ptree_scan_entry;
+
+/* Processes in scan order, every process is also passed on to `cb` */
+typedef struct ptree_scan_ctx {
+    ptree_scan_entry* entries;
+    unsigned count;
+    unsigned capacity;
+    procstat_scan_cb cb;
+    void* priv;
+} ptree_scan_ctx;
+
+static void ptree_scan_cb(const process* proc, void* priv) {
+    ptree_scan_ctx* ctx = (ptree_scan_ctx*) priv;
+    if (ctx->cb != NULL)
+        ctx->cb(proc, ctx->priv);
+
+    /* a zombie with a single thread already exited and is only waiting to be reaped */
+    if (proc->state == 'Z' && proc->threads <= 1)
+        return;
+
+    if (ctx->count == ctx->capacity) {
+        unsigned capacity = ctx->capacity ? ctx->capacity * 2 : PTREE_MIN_SLOTS;
+        ptree_scan_entry* entries = (ptree_scan_entry*) realloc(ctx->entries, capacity * sizeof(ptree_scan_entry));
+        if (entries == NULL)
+            return;
+        ctx->entries = entries;
+        ctx->capacity = capacity;
+    }
+
+    ctx->entries[ctx->count].pid = proc->pid;
+    ctx->entries[ctx->count].ppid = proc->ppid;
+    ctx->entries[ctx->count].leader_exited = proc->state == 'Z';
+    ctx->count++;
+}
+
+/* Parents may be scanned after their children, so every process is inserted before any is linked */
+static bool ptree_rebuild(procstat_scan_cb cb, void* priv) {
+    ptree_scan_ctx ctx = { .cb = cb, .priv = priv };
+    procstat_scan(ptree_scan_cb, &ctx);
+    if (ctx.count == 0) {
+        free(ctx.entries);
+        return false;
+    }
+
+    memset(nodes, 0, slots * sizeof(ptree_node));
+    used = live = 0;
+    roots = 0;
+    for (unsigned i = 0; i < ctx.count; i++) {
+        ptree_node* node = ptree_insert(ctx.entries[i].pid);
+        if (node != NULL)
+            node->leader_exited = ctx.entries[i].leader_exited;
+    }
+
+    /* linking prepends, walking the scan backwards leaves every child list in pid order */
+    for (unsigned i = ctx.count; i-- > 0; ) {
+        ptree_node* node = ptree_find(ctx.entries[i].pid);
+        if (node != NULL)
+            ptree_link(node, ctx.entries[i].ppid);
+    }
+
+    free(ctx.entries);
+    stale = false;
+    return true;
+}
+
+static void ptree_fork(unsigned ppid, unsigned pid) {
+    if (ptree_find(pid) != NULL)
+        return;
+
+    ptree_node* node = ptree_insert(pid);
+    if (node == NULL) {
+        stale = true;
+        return;
+    }
+    ptree_link(node, ppid);
+}
+
+/* The kernel reparents the children before it reports the exit, their new parent is read from procfs */
+static void ptree_exit(unsigned pid) {
+    ptree_node* node = ptree_find(pid);
+    if (node == NULL)
+        return;
+
+    /* a leader leaving before its threads keeps the process alive and the parent of its children */
+    process proc;
+    if (pid_lookup((int)pid, &proc) && proc.threads > 1) {
+        node->leader_exited = true;
+        return;
+    }
+
+    while (node->first_child != 0) {
+        ptree_node* child = ptree_find(node->first_child);
+        unsigned ppid = pid_lookup((int)child->pid, &proc) && proc.ppid != pid ? proc.ppid : 0;
+        ptree_unlink(child);
+        ptree_link(child, ppid);
+    }
+    ptree_unlink(node);
+    ptree_remove(node);
+}
+
+/* Once the leader exited, the process ends with its last thread, which only a scan can tell */
+static void ptree_thread_exit(unsigned tgid) {
+    const ptree_node* node = ptree_find(tgid);
+    if (node != NULL && node->leader_exited)
+        stale = true;
+}
+
+static void ptree_events_cb(struct uloop_fd* u, unsigned int events) {
+    for (;;) {
+        ssize_t n = recv(u->fd, cn_buf, sizeof(cn_buf), MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            if (errno == ENOBUFS) {
+                syslog(LOG_NOTICE, "Process events overflowed, rebuilding the process index");
+                stale = true;
+                continue;
+            }
+            return;
+        }
+
+        /* a stale index is rebuilt from scratch, patching it would be wasted */
+        if (stale)
+            continue;
+
+        int len = (int)n;
+        for (struct nlmsghdr* nh = (struct nlmsghdr*) cn_buf; NLMSG_OK(nh, len); nh = NLMSG_NEXT(nh, len)) {
+            const struct cn_msg* msg = (const struct cn_msg*) NLMSG_DATA(nh);
+            if (msg->id.idx != CN_IDX_PROC || msg->id.val != CN_VAL_PROC)
+                continue;
+
+            /* the event follows the 20 byte connector header and is not aligned for its 64-bit fields */
+            struct proc_event ev = { 0 };
+            memcpy(&ev, msg->data, msg->len < sizeof(ev) ? msg->len : sizeof(ev));
+            switch (ev.what) {
+                case PROC_EVENT_FORK:
+                    /* threads share the process of their thread group leader */
+                    if (ev.event_data.fork.child_pid == ev.event_data.fork.child_tgid)
+                        ptree_fork(ev.event_data.fork.parent_tgid, ev.event_data.fork.child_tgid);
+                    break;
+                case PROC_EVENT_EXIT:
+                    if (ev.event_data.exit.process_pid == ev.event_data.exit.process_tgid)
+                        ptree_exit(ev.event_data.exit.process_tgid);
+                    else
+                        ptree_thread_exit(ev.event_data.exit.process_tgid);
+                    break;
+                default:
+                    break;
+            }
+        }
+    }
+}
+
+static int ptree_subscribe() {
+    int fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC | SOCK_NONBLOCK, NETLINK_CONNECTOR);
+    if (fd < 0)
+        return -1;
+
+    int rcvbuf = 256 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    struct sockaddr_nl addr = {
+        .nl_family = AF_NETLINK,
+        .nl_groups = CN_IDX_PROC,
+    };
+    if (bind(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    struct __attribute__((packed)) {
+        struct nlmsghdr nh;
+        struct cn_msg msg;
+        enum proc_cn_mcast_op op;
+    } req;
+    memset(&req, 0, sizeof(req));
+    req.nh.nlmsg_len = sizeof(req);
+    req.nh.nlmsg_type = NLMSG_DONE;
+    req.msg.id.idx = CN_IDX_PROC;
+    req.msg.id.val = CN_VAL_PROC;
+    req.msg.len = sizeof(req.op);
+    req.op = PROC_CN_MCAST_LISTEN;
+    if (send(fd, &req, sizeof(req), 0) < 0) {
+        close(fd);
+        return -1;
+    }
+
+    cn_events.fd = fd;
+    cn_events.cb = ptree_events_cb;
+    uloop_fd_add(&cn_events, ULOOP_READ);
+    return 0;
+}
+
+int ptree_init() {
+    if (!ptree_rehash())
+        return -1;
+
+    /* subscribe before scanning so no fork falls in between */
+    int rc = ptree_subscribe();
+    if (rc != 0)
+        syslog(LOG_WARNING, "Failed to subscribe to process events, the process index is rebuilt on every call");
+
+    ptree_rebuild(NULL, NULL);
+    return rc;
+}
+
+bool ptree_update(procstat_scan_cb cb, void* priv) {
+    if (slots == 0 && !ptree_rehash())
+        return false;
+    if (stale || cn_events.fd < 0)
+        return ptree_rebuild(cb, priv);
+    return cb == NULL || procstat_scan(cb, priv) > 0;
+}
+
+unsigned ptree_parent(unsigned pid) {
+    const ptree_node* node = ptree_find(pid);
+    return node != NULL ? node->parent : 0;
+}
+
+bool ptree_contains(unsigned pid) {
+    return ptree_find(pid) != NULL;
+}
+
+unsigned ptree_first_child(unsigned pid) {
+    if (pid == 0)
+        return roots;
+
+    const ptree_node* node = ptree_find(pid);
+    return node != NULL ? node->first_child : 0;
+}
+
+unsigned ptree_next_sibling(unsigned pid) {
+    const ptree_node* node = ptree_find(pid);
+    return node != NULL ? node->next_sibling : 0;
+}
+
+unsigned ptree_count() {
+    return live;
+}
+
+void ptree_cleanup() {
+    if (cn_events.fd >= 0) {
+        uloop_fd_delete(&cn_events);
+        close(cn_events.fd);
+        cn_events.fd = -1;
+    }
+    free(nodes);
+    nodes = NULL;
+    slots = used = live = 0;
+    roots = 0;
+    stale = true;
+}
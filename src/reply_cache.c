@@ -0,0 +1,76 @@
+#include "../includes/reply_cache.h"
+#include "../includes/helpers.h"
+#include "../includes/stats.h"
+
+static reply_cache* caches = NULL;
+
+void reply_cache_register(reply_cache* c, unsigned ttl) {
+    c->ttl = ttl;
+    c->valid = false;
+    c->next = caches;
+    caches = c;
+}
+
+bool reply_cache_send(reply_cache* c, struct ubus_context* ctx, struct ubus_request_data* req) {
+    if (c->valid && get_monotonic_ms() - c->stored < c->ttl) {
+        c->hits++;
+        stats_mark(STATS_SEND);
+        ubus_send_reply(ctx, req, c->reply);
+        return true;
+    }
+
+    c->misses++;
+    return false;
+}
+
+void reply_cache_store(reply_cache* c, struct blob_attr* reply) {
+    if (c->ttl == 0)
+        return;
+
+    /* the allocation is kept and only grown, replies of one method are similarly sized */
+    size_t len = blob_raw_len(reply);
+    if (len > c->capacity) {
+        struct blob_attr* grown = (struct blob_attr*) realloc(c->reply, len);
+        if (grown == NULL) {
+            syslog(LOG_WARNING, "Failed to allocate memory for the %s reply cache!", c->name);
+            c->valid = false;
+            return;
+        }
+        c->reply = grown;
+        c->capacity = len;
+    }
+
+    memcpy(c->reply, reply, len);
+    c->stored = get_monotonic_ms();
+    c->valid = true;
+}
+
+void reply_cache_invalidate(reply_cache* c) {
+    c->valid = false;
+}
+
+void reply_cache_invalidate_all() {
+    for (reply_cache* c = caches; c != NULL; c = c->next)
+        reply_cache_invalidate(c);
+}
+
+void reply_cache_reset_counters() {
+    for (reply_cache* c = caches; c != NULL; c = c->next) {
+        c->hits = 0;
+        c->misses = 0;
+    }
+}
+
+const reply_cache* reply_cache_first() {
+    return caches;
+}
+
+void reply_cache_cleanup() {
+    for (reply_cache* c = caches; c != NULL; c = c->next) {
+        free(c->reply);
+        c->reply = NULL;
+        c->capacity = 0;
+        c->valid = false;
+    }
+    caches = NULL;
+}
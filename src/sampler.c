@@ -0,0 +1,184 @@
+#include "../includes/sampler.h"
+
+static sampler_hook* hooks = NULL;
+static unsigned sampler_period = 0;
+
+/* The collector thread hands every tick to the event loop and waits until it was published */
+static pthread_t collector;
+static pthread_mutex_t collector_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t collector_wake;
+static bool collector_running = false;
+static bool collector_stop = false;
+static bool collected = false;
+static struct uloop_fd collected_event = { .fd = -1 };
+
+static void sampler_collect() {
+    for (sampler_hook* hook = hooks; hook != NULL; hook = hook->next) {
+        if (hook->collect == NULL)
+            continue;
+
+        uint64_t start = stats_now_ns();
+        hook->collect();
+        hook->collect_ns = stats_now_ns() - start;
+    }
+}
+
+static void sampler_publish() {
+    for (sampler_hook* hook = hooks; hook != NULL; hook = hook->next) {
+        uint64_t start = stats_now_ns();
+        if (hook->cb != NULL)
+            hook->cb();
+        histogram_record(&hook->latency, hook->collect_ns + stats_now_ns() - start);
+    }
+}
+
+static void sampler_run() {
+    sampler_collect();
+    sampler_publish();
+}
+
+/* Without the collector thread every tick is collected on the event loop */
+static void sampler_tick(struct uloop_timeout* t) {
+    uloop_timeout_set(t, sampler_period);
+    sampler_run();
+}
+
+static struct uloop_timeout sampler_timer = { .cb = sampler_tick };
+
+static void sampler_collected_cb(struct uloop_fd* u, unsigned int events) {
+    uint64_t ticks;
+    if (read(u->fd, &ticks, sizeof(ticks)) != sizeof(ticks))
+        return;
+
+    sampler_publish();
+    pthread_mutex_lock(&collector_lock);
+    collected = false;
+    pthread_cond_signal(&collector_wake);
+    pthread_mutex_unlock(&collector_lock);
+}
+
+/* Ticks keep their period, one that took longer than it is followed right away */
+static void sampler_next_deadline(struct timespec* deadline) {
+    deadline->tv_sec += sampler_period / 1000;
+    deadline->tv_nsec += (long)(sampler_period % 1000) * 1000000;
+    if (deadline->tv_nsec >= 1000000000) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (deadline->tv_sec < now.tv_sec || (deadline->tv_sec == now.tv_sec && deadline->tv_nsec < now.tv_nsec))
+        *deadline = now;
+}
+
+static void* sampler_collector(void* arg) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+    pthread_mutex_lock(&collector_lock);
+    while (!collector_stop) {
+        sampler_next_deadline(&deadline);
+        while (!collector_stop && pthread_cond_timedwait(&collector_wake, &collector_lock, &deadline) == 0)
+            ;
+        if (collector_stop)
+            break;
+
+        pthread_mutex_unlock(&collector_lock);
+        sampler_collect();
+        pthread_mutex_lock(&collector_lock);
+
+        /* until the event loop published the tick, the collectors must not touch their tables */
+        collected = true;
+        uint64_t tick = 1;
+        if (write(collected_event.fd, &tick, sizeof(tick)) < 0)
+            syslog(LOG_WARNING, "Failed to hand a sample to the event loop: %s", strerror(errno));
+        while (!collector_stop && collected)
+            pthread_cond_wait(&collector_wake, &collector_lock);
+    }
+    pthread_mutex_unlock(&collector_lock);
+    return NULL;
+}
+
+static int sampler_start_collector() {
+    collected_event.fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (collected_event.fd < 0)
+        return -1;
+    collected_event.cb = sampler_collected_cb;
+    uloop_fd_add(&collected_event, ULOOP_READ);
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&collector_wake, &attr);
+    pthread_condattr_destroy(&attr);
+
+    /* signals are handled on the event loop, the collector must never run the handlers */
+    sigset_t all, old;
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, &old);
+    collector_stop = false;
+    int rc = pthread_create(&collector, NULL, sampler_collector, NULL);
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+
+    if (rc != 0) {
+        uloop_fd_delete(&collected_event);
+        close(collected_event.fd);
+        collected_event.fd = -1;
+        return -1;
+    }
+    collector_running = true;
+    return 0;
+}
+
+int sampler_init(unsigned interval) {
+    if (interval == 0) {
+        syslog(LOG_ERR, "Sampler interval has to be greater than zero!");
+        return -1;
+    }
+
+    sampler_period = interval;
+    sampler_run();
+    if (sampler_start_collector() == 0)
+        return 0;
+
+    syslog(LOG_WARNING, "Failed to start the collector thread, collecting on the event loop");
+    return uloop_timeout_set(&sampler_timer, sampler_period) == 0 ? 0 : -1;
+}
+
+void sampler_add(sampler_hook* hook) {
+    sampler_hook** tail = &hooks;
+    while (*tail != NULL)
+        tail = &(*tail)->next;
+
+    hook->next = NULL;
+    *tail = hook;
+}
+
+unsigned sampler_interval() {
+    return sampler_period;
+}
+
+sampler_hook* sampler_first() {
+    return hooks;
+}
+
+void sampler_cleanup() {
+    if (collector_running) {
+        pthread_mutex_lock(&collector_lock);
+        collector_stop = true;
+        pthread_cond_signal(&collector_wake);
+        pthread_mutex_unlock(&collector_lock);
+        pthread_join(collector, NULL);
+        collector_running = false;
+    }
+    if (collected_event.fd >= 0) {
+        uloop_fd_delete(&collected_event);
+        close(collected_event.fd);
+        collected_event.fd = -1;
+    }
+
+    collected = false;
+    uloop_timeout_cancel(&sampler_timer);
+    hooks = NULL;
+}
@@ -0,0 +1,63 @@
+#include "../includes/snapshot.h"
+
+static snapshot snapshots[SNAPSHOT_BUFFERS];
+/* Indices into snapshots, -1 if none, accessed with sequentially consistent atomics */
+static int published = -1;
+static int reading = -1;
+
+static arena cpu_arena;
+static cpu_info* cpu_static = NULL;
+
+static void snapshot_collect(snapshot* s) {
+    arena_reset(&s->mem);
+    s->info.cpu = cpu_static;
+    s->info.memory = get_mem_info(&s->mem);
+    s->info.network = NULL;
+    s->info.users = NULL;
+    s->taken = get_monotonic_ms();
+}
+
+/* Publishing happens before the reader is checked, a reader that raced it retries in snapshot_acquire */
+static void snapshot_publish() {
+    int current = __atomic_load_n(&published, __ATOMIC_SEQ_CST);
+    int held = __atomic_load_n(&reading, __ATOMIC_SEQ_CST);
+    int spare = 0;
+    while (spare == current || spare == held)
+        spare++;
+
+    snapshot_collect(&snapshots[spare]);
+    __atomic_store_n(&published, spare, __ATOMIC_SEQ_CST);
+}
+
+/* Handlers keep acquiring snapshots while the next one is collected, so it is published by the swap above and not by a cb */
+static sampler_hook snapshot_hook = { .name = "snapshot", .collect = snapshot_publish };
+
+void snapshot_init() {
+    /* vendor, model, caches and address sizes never change, the live data comes from cpustate */
+    cpu_static = get_cpu_info(&cpu_arena);
+    sampler_add(&snapshot_hook);
+}
+
+const snapshot* snapshot_acquire() {
+    int current;
+    do {
+        current = __atomic_load_n(&published, __ATOMIC_SEQ_CST);
+        __atomic_store_n(&reading, current, __ATOMIC_SEQ_CST);
+    } while (current != __atomic_load_n(&published, __ATOMIC_SEQ_CST));
+    return &snapshots[current];
+}
+
+void snapshot_release() {
+    __atomic_store_n(&reading, -1, __ATOMIC_SEQ_CST);
+}
+
+void snapshot_cleanup() {
+    for (unsigned i = 0; i < SNAPSHOT_BUFFERS; i++) {
+        arena_free(&snapshots[i].mem);
+        memset(&snapshots[i].info, 0, sizeof(system_info));
+    }
+    arena_free(&cpu_arena);
+    cpu_static = NULL;
+    published = -1;
+    reading = -1;
+}
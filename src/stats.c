@@ -0,0 +1,170 @@
+#include "../includes/stats.h"
+
+static struct ubus_method* timed_methods = NULL;
+static method_stats* methods_stats = NULL;
+static unsigned methods_count = 0;
+static uint64_t reset_at = 0;
+
+/* The call in progress, handlers run one at a time on the uloop */
+static method_stats* current = NULL;
+static int current_stage = STATS_COLLECT;
+static bool current_failed = false;
+static uint64_t stage_start = 0;
+
+uint64_t stats_now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static unsigned histogram_bucket(uint64_t ns) {
+    if (ns < STATS_SUB_BUCKETS)
+        return ns;
+
+    unsigned msb = 63 - __builtin_clzll(ns);
+    unsigned bucket = (msb - STATS_SUB_BITS + 1) * STATS_SUB_BUCKETS
+        + ((ns >> (msb - STATS_SUB_BITS)) & (STATS_SUB_BUCKETS - 1));
+    return bucket < STATS_BUCKETS ? bucket : STATS_BUCKETS - 1;
+}
+
+uint64_t histogram_bucket_bound(unsigned bucket) {
+    if (bucket < STATS_SUB_BUCKETS)
+        return bucket + 1;
+
+    unsigned exponent = bucket / STATS_SUB_BUCKETS;
+    uint64_t mantissa = STATS_SUB_BUCKETS + bucket % STATS_SUB_BUCKETS + 1;
+    return mantissa << (exponent - 1);
+}
+
+void histogram_record(histogram* h, uint64_t ns) {
+    __atomic_fetch_add(&h->count, 1, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->sum, ns, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&h->buckets[histogram_bucket(ns)], 1, __ATOMIC_RELAXED);
+
+    uint64_t max = __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+    while (ns > max && !__atomic_compare_exchange_n(&h->max, &max, ns, true,
+            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+        ;
+}
+
+uint64_t histogram_percentile(const histogram* h, double p) {
+    uint64_t count = __atomic_load_n(&h->count, __ATOMIC_RELAXED);
+    if (count == 0)
+        return 0;
+
+    uint64_t rank = (uint64_t)(count * p / 100.0 + 0.5);
+    if (rank == 0)
+        rank = 1;
+
+    uint64_t seen = 0;
+    uint64_t max = __atomic_load_n(&h->max, __ATOMIC_RELAXED);
+    for (unsigned i = 0; i < STATS_BUCKETS; i++) {
+        seen += __atomic_load_n(&h->buckets[i], __ATOMIC_RELAXED);
+        if (seen >= rank) {
+            uint64_t bound = histogram_bucket_bound(i);
+            return bound < max ? bound : max;
+        }
+    }
+    return max;
+}
+
+void histogram_reset(histogram* h) {
+    memset(h, 0, sizeof(*h));
+}
+
+static method_stats* stats_lookup(const char* name) {
+    for (unsigned i = 0; i < methods_count; i++) {
+        if (strcmp(methods_stats[i].name, name) == 0)
+            return &methods_stats[i];
+    }
+    return NULL;
+}
+
+static int stats_dispatch(struct ubus_context* ctx, struct ubus_object* obj,
+    struct ubus_request_data* req, const char* method, struct blob_attr* msg)
+{
+    method_stats* s = stats_lookup(method);
+    if (s == NULL)
+        return UBUS_STATUS_METHOD_NOT_FOUND;
+
+    uint64_t start = stats_now_ns();
+    current = s;
+    current_stage = STATS_COLLECT;
+    current_failed = false;
+    stage_start = start;
+
+    int rc = s->handler(ctx, obj, req, method, msg);
+
+    uint64_t end = stats_now_ns();
+    histogram_record(&s->stages[current_stage], end - stage_start);
+    histogram_record(&s->total, end - start);
+    __atomic_fetch_add(&s->calls, 1, __ATOMIC_RELAXED);
+    if (rc != 0 || current_failed)
+        __atomic_fetch_add(&s->errors, 1, __ATOMIC_RELAXED);
+    current = NULL;
+    return rc;
+}
+
+struct ubus_method* stats_wrap(const struct ubus_method* methods, unsigned count) {
+    timed_methods = (struct ubus_method*) malloc(count * sizeof(struct ubus_method));
+    methods_stats = (method_stats*) calloc(count, sizeof(method_stats));
+    if (timed_methods == NULL || methods_stats == NULL) {
+        syslog(LOG_ERR, "Failed to allocate memory for method statistics!");
+        stats_cleanup();
+        return NULL;
+    }
+
+    for (unsigned i = 0; i < count; i++) {
+        timed_methods[i] = methods[i];
+        timed_methods[i].handler = stats_dispatch;
+        methods_stats[i].name = methods[i].name;
+        methods_stats[i].handler = methods[i].handler;
+    }
+    methods_count = count;
+    reset_at = stats_now_ns();
+    return timed_methods;
+}
+
+void stats_mark(int stage) {
+    if (current == NULL || stage == current_stage)
+        return;
+
+    uint64_t now = stats_now_ns();
+    histogram_record(&current->stages[current_stage], now - stage_start);
+    current_stage = stage;
+    stage_start = now;
+}
+
+void stats_error() {
+    current_failed = true;
+}
+
+const method_stats* stats_methods(unsigned* count) {
+    *count = methods_count;
+    return methods_stats;
+}
+
+uint64_t stats_since() {
+    return reset_at;
+}
+
+void stats_reset() {
+    for (unsigned i = 0; i < methods_count; i++) {
+        method_stats* s = &methods_stats[i];
+        s->calls = 0;
+        s->errors = 0;
+        histogram_reset(&s->total);
+        for (unsigned j = 0; j < __STATS_STAGE_MAX; j++)
+            histogram_reset(&s->stages[j]);
+    }
+    reset_at = stats_now_ns();
+}
+
+void stats_cleanup() {
+    free(timed_methods);
+    free(methods_stats);
+    timed_methods = NULL;
+    methods_stats = NULL;
+    methods_count = 0;
+    current = NULL;
+}
@@ -0,0 +1,267 @@
+#include "../includes/tsdb.h"
+
+static tsdb_series* series_list = NULL;
+
+/* Bits are written most significant first, a byte at a time, the payload is zeroed when a block is started */
+static void bits_write(tsdb_block* block, uint64_t value, unsigned count) {
+    while (count > 0) {
+        unsigned offset = block->bits & 7;
+        unsigned take = 8 - offset < count ? 8 - offset : count;
+        uint8_t chunk = (uint8_t)((value >> (count - take)) & ((1u << take) - 1));
+        block->data[block->bits >> 3] |= (uint8_t)(chunk << (8 - offset - take));
+        block->bits += take;
+        count -= take;
+    }
+}
+
+static uint64_t bits_read(const tsdb_block* block, uint32_t* pos, unsigned count) {
+    uint64_t value = 0;
+    while (count > 0) {
+        unsigned offset = *pos & 7;
+        unsigned take = 8 - offset < count ? 8 - offset : count;
+        uint8_t byte = block->data[*pos >> 3];
+        value = (value << take) | ((byte >> (8 - offset - take)) & ((1u << take) - 1));
+        *pos += take;
+        count -= take;
+    }
+    return value;
+}
+
+static uint32_t float_bits(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static float bits_float(uint32_t bits) {
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static int64_t sign_extend(uint64_t value, unsigned bits) {
+    uint64_t sign = 1ull << (bits - 1);
+    return (int64_t)((value ^ sign) - sign);
+}
+
+/* Sampler ticks are regular, so the delta of the deltas mostly fits a single bit */
+static void dod_write(tsdb_block* block, int64_t dod) {
+    if (dod == 0) {
+        bits_write(block, 0, 1);
+    } else if (dod >= -64 && dod <= 63) {
+        bits_write(block, 0x2, 2);
+        bits_write(block, (uint64_t)dod & 0x7f, 7);
+    } else if (dod >= -256 && dod <= 255) {
+        bits_write(block, 0x6, 3);
+        bits_write(block, (uint64_t)dod & 0x1ff, 9);
+    } else if (dod >= -2048 && dod <= 2047) {
+        bits_write(block, 0xe, 4);
+        bits_write(block, (uint64_t)dod & 0xfff, 12);
+    } else {
+        bits_write(block, 0xf, 4);
+        bits_write(block, (uint64_t)dod, 64);
+    }
+}
+
+static int64_t dod_read(const tsdb_block* block, uint32_t* pos) {
+    if (bits_read(block, pos, 1) == 0)
+        return 0;
+    if (bits_read(block, pos, 1) == 0)
+        return sign_extend(bits_read(block, pos, 7), 7);
+    if (bits_read(block, pos, 1) == 0)
+        return sign_extend(bits_read(block, pos, 9), 9);
+    if (bits_read(block, pos, 1) == 0)
+        return sign_extend(bits_read(block, pos, 12), 12);
+    return (int64_t)bits_read(block, pos, 64);
+}
+
+/* Consecutive values share sign, exponent and the high mantissa bits, only the XOR window differing is stored */
+static void xor_write(tsdb_series* s, tsdb_block* block, uint32_t value) {
+    uint32_t x = value ^ s->last_value;
+    if (x == 0) {
+        bits_write(block, 0, 1);
+        return;
+    }
+
+    uint8_t leading = (uint8_t)__builtin_clz(x);
+    uint8_t trailing = (uint8_t)__builtin_ctz(x);
+    if (s->leading != UINT8_MAX && leading >= s->leading && trailing >= s->trailing) {
+        bits_write(block, 0x2, 2);
+        bits_write(block, x >> s->trailing, 32 - s->leading - s->trailing);
+        return;
+    }
+
+    unsigned length = 32 - leading - trailing;
+    bits_write(block, 0x3, 2);
+    bits_write(block, leading, 5);
+    bits_write(block, length - 1, 5);
+    bits_write(block, x >> trailing, length);
+    s->leading = leading;
+    s->trailing = trailing;
+}
+
+static uint32_t xor_read(tsdb_iter* it, uint32_t* pos) {
+    const tsdb_block* block = it->block;
+    if (bits_read(block, pos, 1) == 0)
+        return it->value;
+
+    if (bits_read(block, pos, 1) == 1) {
+        it->leading = (uint8_t)bits_read(block, pos, 5);
+        unsigned length = (unsigned)bits_read(block, pos, 5) + 1;
+        it->trailing = (uint8_t)(32 - it->leading - length);
+    }
+    uint32_t x = (uint32_t)bits_read(block, pos, 32 - it->leading - it->trailing) << it->trailing;
+    return it->value ^ x;
+}
+
+static unsigned tsdb_max_blocks(const tsdb_series* s) {
+    unsigned blocks = (unsigned)(s->budget / sizeof(tsdb_block));
+    return blocks < 2 ? 2 : blocks;
+}
+
+/* A full budget recycles the oldest block instead of going back to the allocator */
+static tsdb_block* tsdb_block_start(tsdb_series* s) {
+    tsdb_block* block;
+    if (s->block_count >= tsdb_max_blocks(s)) {
+        block = s->oldest;
+        s->oldest = block->next;
+        s->samples -= block->count;
+    } else {
+        block = (tsdb_block*) malloc(sizeof(tsdb_block));
+        if (block == NULL) {
+            syslog(LOG_ERR, "Failed to allocate a block for the %s series!", s->name);
+            return NULL;
+        }
+        s->block_count++;
+    }
+
+    memset(block, 0, sizeof(tsdb_block));
+    if (s->newest != NULL)
+        s->newest->next = block;
+    else
+        s->oldest = block;
+    s->newest = block;
+    return block;
+}
+
+void tsdb_add(tsdb_series* series) {
+    tsdb_series** tail = &series_list;
+    while (*tail != NULL)
+        tail = &(*tail)->next;
+
+    series->block_count = 0;
+    series->samples = 0;
+    series->oldest = series->newest = NULL;
+    series->next = NULL;
+    *tail = series;
+}
+
+tsdb_series* tsdb_first() {
+    return series_list;
+}
+
+tsdb_series* tsdb_find(const char* name) {
+    for (tsdb_series* s = series_list; s != NULL; s = s->next) {
+        if (strcmp(s->name, name) == 0)
+            return s;
+    }
+    return NULL;
+}
+
+int tsdb_append(tsdb_series* s, uint64_t time_ms, float value) {
+    tsdb_block* block = s->newest;
+    uint32_t bits = float_bits(value);
+    if (block == NULL || block->bits + TSDB_SAMPLE_BITS > TSDB_BLOCK_SIZE * 8) {
+        block = tsdb_block_start(s);
+        if (block == NULL)
+            return -1;
+
+        bits_write(block, time_ms, 64);
+        bits_write(block, bits, 32);
+        block->min_ms = block->max_ms = time_ms;
+        s->last_delta = 0;
+        s->leading = UINT8_MAX;
+    } else {
+        int64_t delta = (int64_t)(time_ms - s->last_ms);
+        dod_write(block, delta - s->last_delta);
+        xor_write(s, block, bits);
+        s->last_delta = delta;
+        if (time_ms < block->min_ms)
+            block->min_ms = time_ms;
+        if (time_ms > block->max_ms)
+            block->max_ms = time_ms;
+    }
+
+    s->last_ms = time_ms;
+    s->last_value = bits;
+    block->count++;
+    s->samples++;
+    return 0;
+}
+
+/* Wall clock steps make timestamps unordered, so blocks are only skipped by their bounds */
+static const tsdb_block* tsdb_iter_seek(const tsdb_block* block, uint64_t from, uint64_t to) {
+    while (block != NULL && (block->max_ms < from || block->min_ms >= to))
+        block = block->next;
+    return block;
+}
+
+static void tsdb_iter_block(tsdb_iter* it, const tsdb_block* block) {
+    it->block = block;
+    it->index = 0;
+    it->pos = 0;
+}
+
+void tsdb_iter_init(tsdb_iter* it, const tsdb_series* series, uint64_t from_ms, uint64_t to_ms) {
+    memset(it, 0, sizeof(tsdb_iter));
+    it->from = from_ms;
+    it->to = to_ms;
+    tsdb_iter_block(it, tsdb_iter_seek(series->oldest, from_ms, to_ms));
+}
+
+bool tsdb_iter_next(tsdb_iter* it, uint64_t* time_ms, float* value) {
+    while (it->block != NULL) {
+        const tsdb_block* block = it->block;
+        if (it->index == block->count) {
+            tsdb_iter_block(it, tsdb_iter_seek(block->next, it->from, it->to));
+            continue;
+        }
+
+        if (it->index == 0) {
+            it->ms = bits_read(block, &it->pos, 64);
+            it->value = (uint32_t)bits_read(block, &it->pos, 32);
+            it->delta = 0;
+            it->leading = 0;
+            it->trailing = 0;
+        } else {
+            it->delta += dod_read(block, &it->pos);
+            it->ms += (uint64_t)it->delta;
+            it->value = xor_read(it, &it->pos);
+        }
+        it->index++;
+
+        if (it->ms >= it->from && it->ms < it->to) {
+            *time_ms = it->ms;
+            *value = bits_float(it->value);
+            return true;
+        }
+    }
+    return false;
+}
+
+void tsdb_cleanup() {
+    for (tsdb_series* s = series_list; s != NULL; ) {
+        tsdb_series* next = s->next;
+        for (tsdb_block* block = s->oldest; block != NULL; ) {
+            tsdb_block* following = block->next;
+            free(block);
+            block = following;
+        }
+        s->oldest = s->newest = NULL;
+        s->block_count = 0;
+        s->samples = 0;
+        s->next = NULL;
+        s = next;
+    }
+    series_list = NULL;
+}
@@ -1,25 +1,117 @@
 #include "../includes/ubus_methods.h"
 
+ubm_config config = {
+    .sample_interval = SAMPLER_INTERVAL,
+    .cache_ttl = REPLY_CACHE_TTL,
+    .socket = NULL,
+    .history = HISTORY_PATH,
+    .series_budget = SERIES_BUDGET,
+};
 struct blob_buf b;
 struct ubus_context* ctx;
-system_info* info = NULL;
 
 static const struct blobmsg_policy signal_policy[] = {
     [PROC_ID] = { .name = "pid", .type = BLOBMSG_TYPE_INT32 },
     [SIGNAL_ID] = { .name = "sig_id", .type = BLOBMSG_TYPE_INT32 },
 };
 
+static const struct blobmsg_policy signal_many_policy[] = {
+    [SIGNAL_MANY_PIDS] = { .name = "pids", .type = BLOBMSG_TYPE_ARRAY },
+    [SIGNAL_MANY_NAME] = { .name = "name", .type = BLOBMSG_TYPE_STRING },
+    [SIGNAL_MANY_SIG] = { .name = "sig_id", .type = BLOBMSG_TYPE_INT32 },
+};
+
 static const struct blobmsg_policy pid_lookup_policy[] = {
     [PROC_ID] = { .name = "pid", .type = BLOBMSG_TYPE_INT32 },
 };
 
+static const struct blobmsg_policy pid_lookup_many_policy[] = {
+    [PROC_IDS] = { .name = "pids", .type = BLOBMSG_TYPE_ARRAY },
+};
+
+static const struct blobmsg_policy top_policy[] = {
+    [TOP_BY] = { .name = "by", .type = BLOBMSG_TYPE_STRING },
+    [TOP_COUNT] = { .name = "count", .type = BLOBMSG_TYPE_INT32 },
+};
+
+static const struct blobmsg_policy ptree_policy[] = {
+    [PTREE_PID] = { .name = "pid", .type = BLOBMSG_TYPE_INT32 },
+};
+
+static const struct blobmsg_policy cache_policy[] = {
+    [CACHE_FLUSH] = { .name = "flush", .type = BLOBMSG_TYPE_BOOL },
+};
+
+static const struct blobmsg_policy subscribe_policy[] = {
+    [SUBSCRIBE_GROUPS] = { .name = "groups", .type = BLOBMSG_TYPE_ARRAY },
+    [SUBSCRIBE_INTERVAL] = { .name = "interval", .type = BLOBMSG_TYPE_INT32 },
+    [SUBSCRIBE_DELTA] = { .name = "delta", .type = BLOBMSG_TYPE_INT32 },
+};
+
+static const struct blobmsg_policy stats_policy[] = {
+    [STATS_RESET] = { .name = "reset", .type = BLOBMSG_TYPE_BOOL },
+    [STATS_HISTOGRAMS] = { .name = "histograms", .type = BLOBMSG_TYPE_BOOL },
+};
+
+static const struct blobmsg_policy info_policy[] = {
+    [INFO_SECTIONS] = { .name = "sections", .type = BLOBMSG_TYPE_ARRAY },
+};
+
+static const struct blobmsg_policy history_policy[] = {
+    [HISTORY_FROM] = { .name = "from", .type = BLOBMSG_TYPE_INT32 },
+    [HISTORY_TO] = { .name = "to", .type = BLOBMSG_TYPE_INT32 },
+    [HISTORY_COUNT] = { .name = "points", .type = BLOBMSG_TYPE_INT32 },
+};
+
+static const struct blobmsg_policy series_policy[] = {
+    [SERIES_NAME] = { .name = "name", .type = BLOBMSG_TYPE_STRING },
+    [SERIES_FROM] = { .name = "from", .type = BLOBMSG_TYPE_INT32 },
+    [SERIES_TO] = { .name = "to", .type = BLOBMSG_TYPE_INT32 },
+    [SERIES_COUNT] = { .name = "points", .type = BLOBMSG_TYPE_INT32 },
+};
+
+static const struct blobmsg_policy mem_policy[] = {
+    [MEM_FIELDS] = { .name = "fields", .type = BLOBMSG_TYPE_ARRAY },
+};
+
+static reply_cache info_cache = { .name = "info" };
+static reply_cache cpu_cache = { .name = "cpu" };
+static reply_cache cpu_usage_cache = { .name = "cpu_usage" };
+static reply_cache memory_cache = { .name = "mem" };
+static reply_cache network_cache = { .name = "net" };
+static reply_cache disk_cache = { .name = "disk" };
+static reply_cache fs_cache = { .name = "fs" };
+
+/* Buckets of the history and series replies, kept at the size of the largest reply */
+static void* bucket_buf = NULL;
+static size_t bucket_buf_size = 0;
+
+/* Processes of the last ptree scan in pid order, joined to the process index by pid */
+static process* ptree_procs = NULL;
+static unsigned ptree_procs_count = 0;
+static unsigned ptree_procs_size = 0;
+static bool ptree_procs_sorted = true;
+
 static const struct ubus_method ubm_methods[] = {
-    UBUS_METHOD_NOARG("info", get_info),
+    UBUS_METHOD("info", get_info, info_policy),
     UBUS_METHOD_NOARG("cpu", get_cpu),
-    UBUS_METHOD_NOARG("mem", get_memory),
+    UBUS_METHOD_NOARG("cpu_usage", get_cpu_usage_method),
+    UBUS_METHOD("mem", get_memory, mem_policy),
     UBUS_METHOD_NOARG("net", get_network),
+    UBUS_METHOD_NOARG("disk", get_disk),
+    UBUS_METHOD_NOARG("fs", get_fs),
+    UBUS_METHOD_NOARG("pressure", get_pressure_method),
+    UBUS_METHOD("history", get_history, history_policy),
+    UBUS_METHOD("series", get_series, series_policy),
     UBUS_METHOD("signal", ub_send_signal, signal_policy),
+    UBUS_METHOD("signal_many", ub_send_signal_many, signal_many_policy),
     UBUS_METHOD("lookup", ub_pid_lookup, pid_lookup_policy),
+    UBUS_METHOD("lookup_many", ub_pid_lookup_many, pid_lookup_many_policy),
+    UBUS_METHOD("top", ub_top, top_policy),
+    UBUS_METHOD("ptree", ub_ptree, ptree_policy),
+    UBUS_METHOD("cache", get_cache_stats, cache_policy),
+    UBUS_METHOD("subscribe", ub_subscribe, subscribe_policy),
+    UBUS_METHOD("stats", get_stats, stats_policy),
 };
 
 static struct ubus_object_type ubm_object_type = 
@@ -32,16 +124,193 @@ static struct ubus_object ubm_object = {
     .n_methods = ARRAY_SIZE(ubm_methods)
 };
 
+/* A new sample makes the cached utilisation stale regardless of its age */
+static void cpu_usage_cache_invalidate() {
+    reply_cache_invalidate(&cpu_usage_cache);
+}
+
+static sampler_hook cpu_usage_cache_hook = { .name = "cpu_usage_cache", .cb = cpu_usage_cache_invalidate };
+
+static tsdb_series metric_series[__METRIC_MAX] = {
+    [METRIC_CPU_USAGE] = { .name = "cpu_usage" },
+    [METRIC_MEM_USED] = { .name = "mem_used" },
+    [METRIC_RX_BPS] = { .name = "rx_bps" },
+    [METRIC_TX_BPS] = { .name = "tx_bps" },
+    [METRIC_LOAD1] = { .name = "load1" },
+    [METRIC_LOAD5] = { .name = "load5" },
+    [METRIC_LOAD15] = { .name = "load15" },
+    [METRIC_TASKS] = { .name = "tasks" },
+    [METRIC_CPU_PRESSURE] = { .name = "cpu_pressure" },
+    [METRIC_MEMORY_PRESSURE] = { .name = "memory_pressure" },
+    [METRIC_IO_PRESSURE] = { .name = "io_pressure" },
+};
+
+static void series_record(const history_record* record) {
+    uint64_t now = record->time_ms;
+    tsdb_append(&metric_series[METRIC_CPU_USAGE], now, record->cpu_usage);
+    tsdb_append(&metric_series[METRIC_MEM_USED], now, record->mem_used);
+    tsdb_append(&metric_series[METRIC_RX_BPS], now, record->rx_bps);
+    tsdb_append(&metric_series[METRIC_TX_BPS], now, record->tx_bps);
+    tsdb_append(&metric_series[METRIC_LOAD1], now, record->load1);
+    tsdb_append(&metric_series[METRIC_LOAD5], now, record->load5);
+    tsdb_append(&metric_series[METRIC_LOAD15], now, record->load15);
+    tsdb_append(&metric_series[METRIC_TASKS], now, record->tasks);
+
+    /* the 10 second averages, queries average them further over their buckets */
+    static const int pressure_metrics[__PRESSURE_MAX] = {
+        [PRESSURE_CPU] = METRIC_CPU_PRESSURE,
+        [PRESSURE_MEMORY] = METRIC_MEMORY_PRESSURE,
+        [PRESSURE_IO] = METRIC_IO_PRESSURE,
+    };
+    for (int i = 0; i < __PRESSURE_MAX; i++) {
+        pressure_info info;
+        if (get_pressure(i, &info))
+            tsdb_append(&metric_series[pressure_metrics[i]], now, info.some.avg10);
+    }
+}
+
+/* Runs after the CPU and interface collectors so the record holds the rates of this tick */
+static void history_record_sample() {
+    const cpu_usage* usage = get_cpu_usage();
+    if (!usage->valid)
+        return;
+
+    history_record record = { .time_ms = get_realtime_ms(), .cpu_usage = usage->total.usage };
+    const memory_info* mem = snapshot_acquire()->info.memory;
+    if (mem != NULL && mem->values[MEMINFO_MEM_TOTAL] > 0) {
+        uint64_t total = mem->values[MEMINFO_MEM_TOTAL];
+        record.mem_used = 100.0 * (total - mem->values[MEMINFO_MEM_AVAILABLE]) / total;
+    }
+    snapshot_release();
+
+    const network_info* net = get_netdev_table();
+    for (unsigned i = 0; net != NULL && i < net->interface_count; i++) {
+        record.rx_bps += net->interfaces[i].rx_bps;
+        record.tx_bps += net->interfaces[i].tx_bps;
+    }
+
+    load_info load;
+    if (get_load_info(&load)) {
+        record.load1 = load.load1;
+        record.load5 = load.load5;
+        record.load15 = load.load15;
+        record.tasks = load.total;
+    }
+    history_append(&record);
+    series_record(&record);
+}
+
+static sampler_hook history_hook = { .name = "history", .cb = history_record_sample };
+
+static struct blob_buf event_buf;
+
+/* Interface table patched from rtnetlink, publish link state changes as ubus events */
+static void network_changed(const _network* net, int change) {
+    reply_cache_invalidate(&network_cache);
+    reply_cache_invalidate(&info_cache);
+    if (change == NETDEV_CHANGED || ctx == NULL)
+        return;
+
+    blob_buf_init(&event_buf, 0);
+    blobmsg_add_string(&event_buf, "name", net->ni_name);
+    blobmsg_add_u32(&event_buf, "index", net->ni_index);
+    blobmsg_add_u32(&event_buf, "flags", net->ni_flags);
+    switch (change) {
+        case NETDEV_LINK_UP:
+            blobmsg_add_string(&event_buf, "state", "up");
+            break;
+        case NETDEV_LINK_DOWN:
+            blobmsg_add_string(&event_buf, "state", "down");
+            break;
+        default:
+            blobmsg_add_string(&event_buf, "state", "removed");
+            break;
+    }
+    blobmsg_add_u32(&event_buf, "requested", get_timestamp());
+    ubus_send_event(ctx, "ubm.link", event_buf.head);
+}
+
+static void add_pressure(struct blob_buf* buf, const char* name, const pressure_avg* avg);
+
+/* A PSI trigger fired, publish the pressure of the stalled resource right away */
+static void pressure_stalled(int resource) {
+    pressure_info info;
+    if (ctx == NULL || !get_pressure(resource, &info))
+        return;
+
+    blob_buf_init(&event_buf, 0);
+    blobmsg_add_string(&event_buf, "resource", pressure_name(resource));
+    add_pressure(&event_buf, "some", &info.some);
+    if (info.has_full)
+        add_pressure(&event_buf, "full", &info.full);
+    blobmsg_add_u32(&event_buf, "stall_us", PSI_TRIGGER_STALL);
+    blobmsg_add_u32(&event_buf, "window_us", PSI_TRIGGER_WINDOW);
+    blobmsg_add_u32(&event_buf, "requested", get_timestamp());
+    ubus_send_event(ctx, "ubm.pressure", event_buf.head);
+}
+
+static bool collect_cpu_usage(struct blob_buf* buf, double* value);
+static bool collect_memory(struct blob_buf* buf, double* value);
+static bool collect_network(struct blob_buf* buf, double* value);
+static bool collect_processes(struct blob_buf* buf, double* value);
+
+/* Metric groups published to subscribers, the index of a group is its bit in the subscription mask */
+static const feed_group feed_groups[] = {
+    { .name = "cpu_usage", .relative = false, .collect = collect_cpu_usage },
+    { .name = "memory", .relative = false, .collect = collect_memory },
+    { .name = "network", .relative = true, .collect = collect_network },
+    { .name = "processes", .relative = true, .collect = collect_processes },
+};
+
 int initialize_ubus() {
     uloop_init();
-    blank_sysinf_init(&info);
+    if (procfs_init(NULL) != 0)
+        return -3;
 
-    ctx = ubus_connect(NULL);
+    ctx = ubus_connect(config.socket);
     if (!ctx) {
         syslog(LOG_CRIT, "Failed to initialize UBus!");
         return -1;
     }
     ubus_add_uloop(ctx);
+    users_init();
+
+    reply_cache_register(&info_cache, config.cache_ttl);
+    reply_cache_register(&cpu_cache, config.cache_ttl);
+    reply_cache_register(&memory_cache, config.cache_ttl);
+    reply_cache_register(&network_cache, config.cache_ttl);
+    reply_cache_register(&disk_cache, config.cache_ttl);
+    reply_cache_register(&fs_cache, config.cache_ttl);
+    reply_cache_register(&cpu_usage_cache, config.cache_ttl ? config.sample_interval : 0);
+
+    snapshot_init();
+    cpu_usage_init();
+    cpustate_init(NULL);
+    sampler_add(&cpu_usage_cache_hook);
+    netdev_init();
+    netdev_set_change_cb(network_changed);
+    diskstats_init();
+    fsusage_init();
+    pressure_init();
+    pressure_set_stall_cb(pressure_stalled);
+    history_init(config.history, HISTORY_CAPACITY);
+    for (unsigned i = 0; i < __METRIC_MAX; i++) {
+        metric_series[i].budget = (size_t)config.series_budget * 1024;
+        tsdb_add(&metric_series[i]);
+    }
+    sampler_add(&history_hook);
+    ptree_init();
+    feeds_init(ctx, feed_groups, ARRAY_SIZE(feed_groups));
+    if (sampler_init(config.sample_interval) != 0) {
+        syslog(LOG_CRIT, "Failed to start the sampler!");
+        ubus_free(ctx);
+        uloop_done();
+        return -4;
+    }
+
+    struct ubus_method* timed = stats_wrap(ubm_methods, ARRAY_SIZE(ubm_methods));
+    if (timed != NULL)
+        ubm_object.methods = timed;
 
     int rc = ubus_add_object(ctx, &ubm_object);
     if (rc) {
@@ -60,223 +329,860 @@ int initialize_ubus() {
 
 void ubus_methods_cleanup() {
     blob_buf_free(&b);
-    sysinf_cleanup(&info);
+    blob_buf_free(&event_buf);
+    free(bucket_buf);
+    bucket_buf = NULL;
+    bucket_buf_size = 0;
+    free(ptree_procs);
+    ptree_procs = NULL;
+    ptree_procs_count = ptree_procs_size = 0;
+    sampler_cleanup();
+    snapshot_cleanup();
+    cpu_usage_cleanup();
+    cpustate_cleanup();
+    netdev_cleanup();
+    diskstats_cleanup();
+    fsusage_cleanup();
+    pressure_cleanup();
+    history_cleanup();
+    tsdb_cleanup();
+    feeds_cleanup();
+    reply_cache_cleanup();
+    users_cleanup();
+    ptree_cleanup();
+    procstat_cleanup();
+    procfs_cleanup();
     if (ctx) {
         ubus_free(ctx);
         uloop_done();
     }
+    stats_cleanup();
+}
+
+static void add_interface(struct blob_buf* buf, const _network* interface, const network_info* net_info) {
+    blobmsg_add_string(buf, "name", interface->ni_name);
+    blobmsg_add_u32(buf, "flags", interface->ni_flags);
+    blobmsg_add_u32(buf, "index", interface->ni_index);
+    blobmsg_add_u64(buf, "rx_bytes", interface->stats.rx_bytes);
+    blobmsg_add_u64(buf, "tx_bytes", interface->stats.tx_bytes);
+    blobmsg_add_u64(buf, "rx_packets", interface->stats.rx_packets);
+    blobmsg_add_u64(buf, "tx_packets", interface->stats.tx_packets);
+    blobmsg_add_u64(buf, "rx_errors", interface->stats.rx_errors);
+    blobmsg_add_u64(buf, "tx_errors", interface->stats.tx_errors);
+    blobmsg_add_u64(buf, "rx_dropped", interface->stats.rx_dropped);
+    blobmsg_add_u64(buf, "tx_dropped", interface->stats.tx_dropped);
+    blobmsg_add_double(buf, "rx_bps", interface->rx_bps);
+    blobmsg_add_double(buf, "tx_bps", interface->tx_bps);
+
+    void* cookie = blobmsg_open_array(buf, "addresses");
+    for (unsigned i = 0; i < net_info->address_count; i++) {
+        const net_address* addr = &net_info->addresses[i];
+        if (addr->ni_index != interface->ni_index)
+            continue;
+
+        char cidr[INET6_ADDRSTRLEN + 4];
+        snprintf(cidr, sizeof(cidr), "%s/%u", addr->address, addr->prefix_len);
+        blobmsg_add_string(buf, NULL, cidr);
+    }
+    blobmsg_close_array(buf, cookie);
+}
+
+static void add_memory(struct blob_buf* buf, const memory_info* mem) {
+    void* cookie = blobmsg_open_table(buf, "memory");
+    blobmsg_add_u64(buf, "memory_total", mem->values[MEMINFO_MEM_TOTAL]);
+    blobmsg_add_u64(buf, "memory_free", mem->values[MEMINFO_MEM_FREE]);
+    blobmsg_add_u64(buf, "memory_available", mem->values[MEMINFO_MEM_AVAILABLE]);
+    blobmsg_add_u64(buf, "memory_cached", mem->values[MEMINFO_CACHED]);
+
+    void* cookie2 = blobmsg_open_table(buf, "memory_swap");
+    blobmsg_add_u64(buf, "m_swap_total", mem->values[MEMINFO_SWAP_TOTAL]);
+    blobmsg_add_u64(buf, "m_swap_free", mem->values[MEMINFO_SWAP_FREE]);
+    blobmsg_add_u64(buf, "m_swap_cached", mem->values[MEMINFO_SWAP_CACHED]);
+    blobmsg_close_table(buf, cookie2);
+    blobmsg_close_table(buf, cookie);
+}
+
+/* Fields are named as in /proc/meminfo, the ones the kernel does not report are left out */
+static void add_meminfo_fields(struct blob_buf* buf, const memory_info* mem, uint64_t fields) {
+    void* cookie = blobmsg_open_table(buf, "meminfo");
+    for (unsigned i = 0; i < __MEMINFO_MAX; i++) {
+        uint64_t bit = (uint64_t)1 << i;
+        if ((fields & bit) && (mem->present & bit))
+            blobmsg_add_u64(buf, meminfo_name(i), mem->values[i]);
+    }
+    blobmsg_close_table(buf, cookie);
+}
+
+static void add_cpu_state(struct blob_buf* buf, const cpu_state* state) {
+    void* cookie = blobmsg_open_array(buf, "cores");
+    for (unsigned i = 0; i < state->core_count; i++) {
+        const core_freq* core = &state->cores[i];
+        if (!core->valid)
+            continue;
+        void* cookie2 = blobmsg_open_table(buf, NULL);
+        blobmsg_add_u32(buf, "cpu", core->cpu);
+        blobmsg_add_double(buf, "cur_mhz", core->cur_khz / 1000.0);
+        blobmsg_add_double(buf, "min_mhz", core->min_khz / 1000.0);
+        blobmsg_add_double(buf, "max_mhz", core->max_khz / 1000.0);
+        blobmsg_close_table(buf, cookie2);
+    }
+    blobmsg_close_array(buf, cookie);
+
+    cookie = blobmsg_open_array(buf, "thermal");
+    for (unsigned i = 0; i < state->zone_count; i++) {
+        const thermal_zone* zone = &state->zones[i];
+        if (!zone->valid)
+            continue;
+        void* cookie2 = blobmsg_open_table(buf, NULL);
+        blobmsg_add_u32(buf, "zone", zone->zone);
+        blobmsg_add_string(buf, "type", zone->type);
+        blobmsg_add_double(buf, "temp", zone->temp_mc / 1000.0);
+        blobmsg_close_table(buf, cookie2);
+    }
+    blobmsg_close_array(buf, cookie);
+    blobmsg_add_u32(buf, "sampled", state->sampled);
+}
+
+static void add_cpu(struct blob_buf* buf, const cpu_info* cpu) {
+    if (cpu == NULL) {
+        blobmsg_add_string(buf, "cpu_msg", "failed to obtain");
+        return;
+    }
+
+    void* cookie = blobmsg_open_table(buf, "cpu");
+    blobmsg_add_u32(buf, "cpu_count", cpu->cpus_active);
+    void* cookie2 = blobmsg_open_array(buf, "cpus");
+    for (unsigned i = 0; i < cpu->cpus_active; i++) {
+        const _cpu_info* c_cpu = &cpu->cpus[i];
+        void* cookie3 = blobmsg_open_table(buf, NULL);
+        blobmsg_add_string(buf, "vendor_id", c_cpu->vendor);
+        blobmsg_add_string(buf, "model_name", c_cpu->model);
+        blobmsg_add_u32(buf, "cores", c_cpu->cores);
+        blobmsg_add_u32(buf, "cache_size", c_cpu->cache_size);
+        blobmsg_add_u32(buf, "cache_align", c_cpu->cache_align);
+        blobmsg_add_string(buf, "address_sizes", c_cpu->address_sizes);
+        blobmsg_close_table(buf, cookie3);
+    }
+    blobmsg_close_array(buf, cookie2);
+    add_cpu_state(buf, get_cpu_state());
+    blobmsg_close_table(buf, cookie);
+}
+
+static void add_info_cpu(struct blob_buf* buf, const system_info* info) {
+    add_cpu(buf, info->cpu);
+}
+
+static void add_info_memory(struct blob_buf* buf, const system_info* info) {
+    if (info->memory != NULL) {
+        add_memory(buf, info->memory);
+    } else {
+        blobmsg_add_string(buf, "memory_msg", "failed to obtain");
+    }
+}
+
+static void add_info_network(struct blob_buf* buf, const system_info* info) {
+    const network_info* interfaces = get_netdev_table();
+    if (interfaces == NULL) {
+        blobmsg_add_string(buf, "network_msg", "failed to obtain");
+        return;
+    }
+
+    void* cookie = blobmsg_open_table(buf, "network");
+    blobmsg_add_u32(buf, "interface_count", interfaces->interface_count);
+    void* cookie2 = blobmsg_open_array(buf, "interfaces");
+    for (unsigned i = 0; i < interfaces->interface_count; i++) {
+        void* cookie3 = blobmsg_open_table(buf, NULL);
+        add_interface(buf, &interfaces->interfaces[i], interfaces);
+        blobmsg_close_table(buf, cookie3);
+    }
+    blobmsg_close_array(buf, cookie2);
+    blobmsg_close_table(buf, cookie);
+}
+
+static void add_info_users(struct blob_buf* buf, const system_info* info) {
+    const user_list* users = get_current_users();
+    if (users == NULL)
+        return;
+
+    if (users->count > 0)
+        blobmsg_add_string(buf, "current_user", users->names[0]);
+    void* cookie = blobmsg_open_array(buf, "users");
+    for (unsigned i = 0; i < users->count; i++)
+        blobmsg_add_string(buf, NULL, users->names[i]);
+    blobmsg_close_array(buf, cookie);
+}
+
+static void add_info_uptime(struct blob_buf* buf, const system_info* info) {
+    long uptime = get_uptime();
+    if (uptime >= 0) {
+        char uptime_str[32];
+        snprintf(uptime_str, sizeof(uptime_str), "%ld", uptime);
+        blobmsg_add_string(buf, "uptime", uptime_str);
+    } else {
+        blobmsg_add_string(buf, "uptime_msg", "failed to obtain");
+    }
+}
+
+/* Sections of the info reply in reply order, the index of a section is its bit in the projection mask */
+static const info_section info_sections[] = {
+    { .name = "cpu", .snapshot = true, .add = add_info_cpu },
+    { .name = "memory", .snapshot = true, .add = add_info_memory },
+    { .name = "network", .snapshot = false, .add = add_info_network },
+    { .name = "users", .snapshot = false, .add = add_info_users },
+    { .name = "uptime", .snapshot = false, .add = add_info_uptime },
+};
+
+static int info_section_index(const char* name) {
+    for (unsigned i = 0; i < ARRAY_SIZE(info_sections); i++) {
+        if (strcmp(info_sections[i].name, name) == 0)
+            return (int)i;
+    }
+    return -1;
 }
 
 int get_info(struct ubus_context *ctx, struct ubus_object *obj,
         struct ubus_request_data *req, const char *method,
         struct blob_attr *msg) 
         {
-            if (info != NULL) {
-                if (!PRESERVE_CPU_DATA)
-                    cpuinf_cleanup(&(info->cpu));
-                meminf_cleanup(&(info->memory));
-                netinf_cleanup(&(info->network));
-                free(info->current_user);
+            struct blob_attr* tb[__INFO_MAX];
+            blobmsg_parse(info_policy, ARRAY_SIZE(info_policy), tb, blob_data(msg), blob_len(msg));
+
+            /* Only the full reply is cached, a projection is answered from the snapshot */
+            if (!tb[INFO_SECTIONS] && reply_cache_send(&info_cache, ctx, req))
+                return 0;
+
+            unsigned sections = (1u << ARRAY_SIZE(info_sections)) - 1;
+            if (tb[INFO_SECTIONS]) {
+                sections = 0;
+                struct blob_attr* cur;
+                size_t rem;
+                blobmsg_for_each_attr(cur, tb[INFO_SECTIONS], rem) {
+                    int index = blobmsg_type(cur) == BLOBMSG_TYPE_STRING ?
+                        info_section_index(blobmsg_get_string(cur)) : -1;
+                    if (index < 0) {
+                        blob_buf_init(&b, 0);
+                        blobmsg_add_string(&b, "error", "unknown info section");
+                        stats_error();
+                        blobmsg_add_u32(&b, "requested", get_timestamp());
+                        stats_mark(STATS_SEND);
+                        ubus_send_reply(ctx, req, b.head);
+                        return 0;
+                    }
+                    sections |= 1u << index;
+                }
             }
 
-            get_system_info(&info);
-            if (info == NULL){
-                syslog(LOG_CRIT, "Failed to parse any information at all!");
-                return -1;
+            bool snapshot = false;
+            for (unsigned i = 0; i < ARRAY_SIZE(info_sections); i++) {
+                if ((sections & (1u << i)) && info_sections[i].snapshot)
+                    snapshot = true;
+            }
+            static const system_info none;
+            const system_info* info = snapshot ? &snapshot_acquire()->info : &none;
+
+            stats_mark(STATS_SERIALISE);
+            blob_buf_init(&b, 0);
+            for (unsigned i = 0; i < ARRAY_SIZE(info_sections); i++) {
+                if (sections & (1u << i))
+                    info_sections[i].add(&b, info);
             }
+            if (snapshot)
+                snapshot_release();
+            blobmsg_add_u32(&b, "requested", get_timestamp());
+
+            if (!tb[INFO_SECTIONS])
+                reply_cache_store(&info_cache, b.head);
+            stats_mark(STATS_SEND);
+            ubus_send_reply(ctx, req, b.head);
+            return 0;
+        }
+
+int get_cpu(struct ubus_context *ctx, struct ubus_object *obj,
+        struct ubus_request_data *req, const char *method,
+        struct blob_attr *msg)
+        {
+            if (reply_cache_send(&cpu_cache, ctx, req))
+                return 0;
+
+            const system_info* info = &snapshot_acquire()->info;
 
+            stats_mark(STATS_SERIALISE);
             blob_buf_init(&b, 0);
 
-            void *cookie, *cookie2, *cookie3;
-            if (info->cpu != NULL) {
-                cookie = blobmsg_open_table(&b, "cpu");
-                blobmsg_add_u32(&b, "cpu_count", info->cpu->cpus_active);
-                cookie2 = blobmsg_open_array(&b, "cpus");
-                for (int i = 0; i < MAX_CPUS; i++) {
-                    _cpu_info* c_cpu = info->cpu->cpus[i];
-                    if (c_cpu != NULL) {
-                        cookie3 = blobmsg_open_table(&b, NULL);
-                        blobmsg_add_string(&b, "vendor_id", c_cpu->vendor);
-                        blobmsg_add_string(&b, "model_name", c_cpu->model);
-                        blobmsg_add_u32(&b, "cores", c_cpu->cores);
-                        blobmsg_add_u32(&b, "cache_size", c_cpu->cache_size);
-                        blobmsg_add_u32(&b, "cache_align", c_cpu->cache_align);
-                        blobmsg_add_double(&b, "cpu_mhz", c_cpu->cpu_mhz);
-                        blobmsg_add_string(&b, "address_sizes", c_cpu->address_sizes);
-                        blobmsg_close_table(&b, cookie3);
+            add_cpu(&b, info->cpu);
+            snapshot_release();
+            blobmsg_add_u32(&b, "requested", get_timestamp());
+            reply_cache_store(&cpu_cache, b.head);
+            stats_mark(STATS_SEND);
+            ubus_send_reply(ctx, req, b.head);
+            return 0;
+        }
+
+int get_memory(struct ubus_context *ctx, struct ubus_object *obj,
+        struct ubus_request_data *req, const char *method,
+        struct blob_attr *msg)
+        {
+            struct blob_attr* tb[__MEM_MAX];
+            blobmsg_parse(mem_policy, ARRAY_SIZE(mem_policy), tb, blob_data(msg), blob_len(msg));
+
+            /* Only the default reply is cached, a field selection is cheap to serialise */
+            if (!tb[MEM_FIELDS] && reply_cache_send(&memory_cache, ctx, req))
+                return 0;
+
+            uint64_t fields = 0;
+            if (tb[MEM_FIELDS]) {
+                struct blob_attr* cur;
+                size_t rem;
+                blobmsg_for_each_attr(cur, tb[MEM_FIELDS], rem) {
+                    const char* name = blobmsg_type(cur) == BLOBMSG_TYPE_STRING ? blobmsg_get_string(cur) : "";
+                    if (strcmp(name, "all") == 0) {
+                        fields = MEMINFO_ALL;
+                        continue;
+                    }
+
+                    int field = meminfo_field(name);
+                    if (field < 0) {
+                        blob_buf_init(&b, 0);
+                        blobmsg_add_string(&b, "error", "unknown meminfo field");
+                        stats_error();
+                        blobmsg_add_u32(&b, "requested", get_timestamp());
+                        stats_mark(STATS_SEND);
+                        ubus_send_reply(ctx, req, b.head);
+                        return 0;
                     }
+                    fields |= (uint64_t)1 << field;
                 }
-                blobmsg_close_array(&b, cookie2);
-                blobmsg_close_table(&b, cookie);
-            } else {
-                blobmsg_add_string(&b, "cpu_msg", "failed to obtain");
             }
 
-            if (info->memory != NULL) {
-                cookie = blobmsg_open_table(&b, "memory");
-                memory_info* mem = info->memory;
-                blobmsg_add_u32(&b, "memory_total", mem->memory_total);
-                blobmsg_add_u32(&b, "memory_free", mem->memory_free);
-                blobmsg_add_u32(&b, "memory_available", mem->memory_available);
-                blobmsg_add_u32(&b, "memory_cached", mem->memory_cached);
-
-                cookie2 = blobmsg_open_table(&b, "memory_swap");
-                swap_info* swap = mem->swap_memory;
-                blobmsg_add_u32(&b, "m_swap_total", swap->swap_total);
-                blobmsg_add_u32(&b, "m_swap_free", swap->swap_free);
-                blobmsg_add_u32(&b, "m_swap_cached", swap->swap_cached);
-                blobmsg_close_table(&b, cookie2);
-                blobmsg_close_table(&b, cookie);
-            } else {
+            const system_info* info = &snapshot_acquire()->info;
+
+            stats_mark(STATS_SERIALISE);
+            blob_buf_init(&b, 0);
+
+            if (info->memory == NULL) {
                 blobmsg_add_string(&b, "memory_msg", "failed to obtain");
+            } else if (tb[MEM_FIELDS]) {
+                add_meminfo_fields(&b, info->memory, fields);
+            } else {
+                add_memory(&b, info->memory);
             }
+            snapshot_release();
+            blobmsg_add_u32(&b, "requested", get_timestamp());
+            if (!tb[MEM_FIELDS])
+                reply_cache_store(&memory_cache, b.head);
+            stats_mark(STATS_SEND);
+            ubus_send_reply(ctx, req, b.head);
+            return 0;
+        }
+
+int get_network(struct ubus_context *ctx, struct ubus_object *obj,
+        struct ubus_request_data *req, const char *method,
+        struct blob_attr *msg)
+        {
+            if (reply_cache_send(&network_cache, ctx, req))
+                return 0;
 
-            if (info->network != NULL) {
-                cookie = blobmsg_open_table(&b, "network");
-                network_info* interfaces = info->network;
+            const network_info* interfaces = get_netdev_table();
+            stats_mark(STATS_SERIALISE);
+            blob_buf_init(&b, 0);
+
+            void *cookie, *cookie2;
+            if (interfaces != NULL) {
                 blobmsg_add_u32(&b, "interface_count", interfaces->interface_count);
-                cookie2 = blobmsg_open_array(&b, "interfaces");
-                for (int i = 0; i < interfaces->interface_count; i++) {
-                    cookie3 = blobmsg_open_table(&b, NULL);
-                    _network* interface = interfaces->interfaces[i];
-                    blobmsg_add_string(&b, "name", interface->ni_name);
-                    blobmsg_add_u32(&b, "flags", interface->ni_flags);
-                    blobmsg_close_table(&b, cookie3);
+                cookie = blobmsg_open_array(&b, "interfaces");
+                for (unsigned i = 0; i < interfaces->interface_count; i++) {
+                    cookie2 = blobmsg_open_table(&b, NULL);
+                    const _network* interface = &interfaces->interfaces[i];
+                    add_interface(&b, interface, interfaces);
+                    blobmsg_close_table(&b, cookie2);
                 }
-                blobmsg_close_array(&b, cookie2);
-                blobmsg_close_table(&b, cookie);
+                blobmsg_close_array(&b, cookie);
             } else {
                 blobmsg_add_string(&b, "network_msg", "failed to obtain");
             }
+            blobmsg_add_u32(&b, "requested", get_timestamp());
+            reply_cache_store(&network_cache, b.head);
+            stats_mark(STATS_SEND);
+            ubus_send_reply(ctx, req, b.head);
+            return 0;
+        }
 
-            blobmsg_add_string(&b, "current_user", info->current_user);
+static void add_cpu_load(struct blob_buf* buf, const cpu_load* load) {
+    blobmsg_add_double(buf, "user", load->user);
+    blobmsg_add_double(buf, "system", load->system);
+    blobmsg_add_double(buf, "iowait", load->iowait);
+    blobmsg_add_double(buf, "irq", load->irq);
+    blobmsg_add_double(buf, "steal", load->steal);
+    blobmsg_add_double(buf, "idle", load->idle);
+    blobmsg_add_double(buf, "usage", load->usage);
+}
 
-            char* uptime = get_uptime();
-            blobmsg_add_string(&b, "uptime", uptime);
-            blobmsg_add_u32(&b, "requested", get_timestamp());
+static void add_cpu_usage(struct blob_buf* buf, const cpu_usage* usage) {
+    void* cookie = blobmsg_open_table(buf, "total");
+    add_cpu_load(buf, &usage->total);
+    blobmsg_close_table(buf, cookie);
 
-            free(uptime);
+    cookie = blobmsg_open_array(buf, "cores");
+    for (unsigned i = 0; i < usage->core_count; i++) {
+        void* cookie2 = blobmsg_open_table(buf, NULL);
+        blobmsg_add_u32(buf, "cpu", usage->cores[i].id);
+        add_cpu_load(buf, &usage->cores[i]);
+        blobmsg_close_table(buf, cookie2);
+    }
+    blobmsg_close_array(buf, cookie);
+    blobmsg_add_u32(buf, "sampled", usage->sampled);
+}
+
+int get_cpu_usage_method(struct ubus_context *ctx, struct ubus_object *obj,
+        struct ubus_request_data *req, const char *method,
+        struct blob_attr *msg)
+        {
+            if (reply_cache_send(&cpu_usage_cache, ctx, req))
+                return 0;
+
+            const cpu_usage* usage = get_cpu_usage();
+            stats_mark(STATS_SERIALISE);
+            blob_buf_init(&b, 0);
+
+            if (usage->valid) {
+                add_cpu_usage(&b, usage);
+            } else {
+                blobmsg_add_string(&b, "cpu_usage_msg", "not sampled yet");
+            }
+            blobmsg_add_u32(&b, "interval", sampler_interval());
+            blobmsg_add_u32(&b, "requested", get_timestamp());
+            reply_cache_store(&cpu_usage_cache, b.head);
+            stats_mark(STATS_SEND);
             ubus_send_reply(ctx, req, b.head);
             return 0;
         }
 
-int get_cpu(struct ubus_context *ctx, struct ubus_object *obj,
+static void add_disk(struct blob_buf* buf, const disk_info* disk, bool rates) {
+    blobmsg_add_string(buf, "name", disk->name);
+    blobmsg_add_u64(buf, "reads", disk->reads);
+    blobmsg_add_u64(buf, "reads_merged", disk->reads_merged);
+    blobmsg_add_u64(buf, "sectors_read", disk->sectors_read);
+    blobmsg_add_u64(buf, "read_ms", disk->read_ms);
+    blobmsg_add_u64(buf, "writes", disk->writes);
+    blobmsg_add_u64(buf, "writes_merged", disk->writes_merged);
+    blobmsg_add_u64(buf, "sectors_written", disk->sectors_written);
+    blobmsg_add_u64(buf, "write_ms", disk->write_ms);
+    blobmsg_add_u64(buf, "in_flight", disk->in_flight);
+    blobmsg_add_u64(buf, "io_ms", disk->io_ms);
+    blobmsg_add_u64(buf, "weighted_io_ms", disk->weighted_io_ms);
+    if (rates) {
+        blobmsg_add_double(buf, "read_iops", disk->read_iops);
+        blobmsg_add_double(buf, "write_iops", disk->write_iops);
+        blobmsg_add_double(buf, "read_bps", disk->read_bps);
+        blobmsg_add_double(buf, "write_bps", disk->write_bps);
+        blobmsg_add_double(buf, "busy", disk->busy);
+    }
+}
+
+int get_disk(struct ubus_context *ctx, struct ubus_object *obj,
         struct ubus_request_data *req, const char *method,
         struct blob_attr *msg)
         {
-            if (info != NULL) {
-                if (!(bool)PRESERVE_CPU_DATA) {
-                    cpuinf_cleanup(&(info->cpu));
-                    info->cpu = get_cpu_info();
-                } else {
-                    if (info->cpu == NULL)
-                        info->cpu = get_cpu_info();
+            if (reply_cache_send(&disk_cache, ctx, req))
+                return 0;
+
+            const disk_table* disks = get_disk_table();
+            stats_mark(STATS_SERIALISE);
+            blob_buf_init(&b, 0);
+
+            if (disks != NULL) {
+                blobmsg_add_u32(&b, "disk_count", disks->disk_count);
+                void* cookie = blobmsg_open_array(&b, "disks");
+                for (unsigned i = 0; i < disks->disk_count; i++) {
+                    void* cookie2 = blobmsg_open_table(&b, NULL);
+                    add_disk(&b, &disks->disks[i], disks->rates);
+                    blobmsg_close_table(&b, cookie2);
                 }
+                blobmsg_close_array(&b, cookie);
+                blobmsg_add_u32(&b, "sampled", disks->sampled);
             } else {
-                get_system_info(&info);
+                blobmsg_add_string(&b, "disk_msg", "not sampled yet");
             }
+            blobmsg_add_u32(&b, "interval", sampler_interval());
+            blobmsg_add_u32(&b, "requested", get_timestamp());
+            reply_cache_store(&disk_cache, b.head);
+            stats_mark(STATS_SEND);
+            ubus_send_reply(ctx, req, b.head);
+            return 0;
+        }
+
+static void add_mount(struct blob_buf* buf, const fs_mount* mount) {
+    blobmsg_add_string(buf, "mount", mount->target);
+    blobmsg_add_string(buf, "source", mount->source);
+    blobmsg_add_string(buf, "type", mount->fstype);
+    blobmsg_add_u8(buf, "readonly", mount->readonly);
+    blobmsg_add_u64(buf, "total", mount->total);
+    blobmsg_add_u64(buf, "free", mount->free);
+    blobmsg_add_u64(buf, "available", mount->available);
+    blobmsg_add_double(buf, "used_percent", mount->used_percent);
+    blobmsg_add_u64(buf, "inodes", mount->inodes);
+    blobmsg_add_u64(buf, "inodes_free", mount->inodes_free);
+    blobmsg_add_double(buf, "inodes_percent", mount->inodes_percent);
+}
 
+int get_fs(struct ubus_context *ctx, struct ubus_object *obj,
+        struct ubus_request_data *req, const char *method,
+        struct blob_attr *msg)
+        {
+            if (reply_cache_send(&fs_cache, ctx, req))
+                return 0;
+
+            const fs_table* fs = get_fs_table();
+            stats_mark(STATS_SERIALISE);
             blob_buf_init(&b, 0);
 
-            void *cookie, *cookie2, *cookie3;
-            if (info->cpu != NULL) {
-                cookie = blobmsg_open_table(&b, "cpu");
-                blobmsg_add_u32(&b, "cpu_count", info->cpu->cpus_active);
-                cookie2 = blobmsg_open_array(&b, "cpus");
-                for (int i = 0; i < MAX_CPUS; i++) {
-                    _cpu_info* c_cpu = info->cpu->cpus[i];
-                    if (c_cpu != NULL) {
-                        cookie3 = blobmsg_open_table(&b, NULL);
-                        blobmsg_add_string(&b, "vendor_id", c_cpu->vendor);
-                        blobmsg_add_string(&b, "model_name", c_cpu->model);
-                        blobmsg_add_u32(&b, "cores", c_cpu->cores);
-                        blobmsg_add_u32(&b, "cache_size", c_cpu->cache_size);
-                        blobmsg_add_u32(&b, "cache_align", c_cpu->cache_align);
-                        blobmsg_add_double(&b, "cpu_mhz", c_cpu->cpu_mhz);
-                        blobmsg_add_string(&b, "address_sizes", c_cpu->address_sizes);
-                        blobmsg_close_table(&b, cookie3);
-                    }
+            if (fs != NULL) {
+                void* cookie = blobmsg_open_array(&b, "filesystems");
+                for (unsigned i = 0; i < fs->mount_count; i++) {
+                    if (!fs->mounts[i].valid)
+                        continue;
+                    void* cookie2 = blobmsg_open_table(&b, NULL);
+                    add_mount(&b, &fs->mounts[i]);
+                    blobmsg_close_table(&b, cookie2);
                 }
-                blobmsg_close_array(&b, cookie2);
-                blobmsg_close_table(&b, cookie);
+                blobmsg_close_array(&b, cookie);
+                blobmsg_add_u32(&b, "sampled", fs->sampled);
             } else {
-                blobmsg_add_string(&b, "cpu_msg", "failed to obtain");
+                blobmsg_add_string(&b, "fs_msg", "not sampled yet");
             }
+            blobmsg_add_u32(&b, "interval", sampler_interval());
             blobmsg_add_u32(&b, "requested", get_timestamp());
+            reply_cache_store(&fs_cache, b.head);
+            stats_mark(STATS_SEND);
             ubus_send_reply(ctx, req, b.head);
             return 0;
         }
 
-int get_memory(struct ubus_context *ctx, struct ubus_object *obj,
+static void add_pressure(struct blob_buf* buf, const char* name, const pressure_avg* avg) {
+    void* cookie = blobmsg_open_table(buf, name);
+    blobmsg_add_double(buf, "avg10", avg->avg10);
+    blobmsg_add_double(buf, "avg60", avg->avg60);
+    blobmsg_add_double(buf, "avg300", avg->avg300);
+    blobmsg_add_u64(buf, "total", avg->total);
+    blobmsg_close_table(buf, cookie);
+}
+
+int get_pressure_method(struct ubus_context *ctx, struct ubus_object *obj,
         struct ubus_request_data *req, const char *method,
         struct blob_attr *msg)
         {
-            if (info != NULL)
-                meminf_cleanup(&(info->memory));
+            stats_mark(STATS_SERIALISE);
+            blob_buf_init(&b, 0);
+
+            bool any = false;
+            for (int i = 0; i < __PRESSURE_MAX; i++) {
+                pressure_info info;
+                if (!get_pressure(i, &info))
+                    continue;
 
-            info->memory = get_mem_info();
-            if (info == NULL){
-                syslog(LOG_CRIT, "Failed to parse any memory information at all!");
-                return -1;
+                void* cookie = blobmsg_open_table(&b, pressure_name(i));
+                add_pressure(&b, "some", &info.some);
+                if (info.has_full)
+                    add_pressure(&b, "full", &info.full);
+                blobmsg_add_u8(&b, "trigger", pressure_triggered(i));
+                blobmsg_close_table(&b, cookie);
+                any = true;
             }
+            if (!any)
+                blobmsg_add_string(&b, "pressure_msg", "not supported");
+            blobmsg_add_u32(&b, "requested", get_timestamp());
+            stats_mark(STATS_SEND);
+            ubus_send_reply(ctx, req, b.head);
+            return 0;
+        }
+
+static void* reply_buckets(size_t size) {
+    if (size > bucket_buf_size) {
+        void* grown = realloc(bucket_buf, size);
+        if (grown == NULL) {
+            syslog(LOG_ERR, "Failed to allocate memory for the reply buckets!");
+            return NULL;
+        }
+        bucket_buf = grown;
+        bucket_buf_size = size;
+    }
+    memset(bucket_buf, 0, size);
+    return bucket_buf;
+}
+
+static void history_bucket_add(history_bucket* bucket, const history_record* record) {
+    bucket->samples++;
+    bucket->time_ms += record->time_ms;
+    if (record->cpu_usage > bucket->cpu_max)
+        bucket->cpu_max = record->cpu_usage;
+    bucket->cpu_usage += record->cpu_usage;
+    bucket->mem_used += record->mem_used;
+    bucket->rx_bps += record->rx_bps;
+    bucket->tx_bps += record->tx_bps;
+    bucket->load1 += record->load1;
+    bucket->load5 += record->load5;
+    bucket->load15 += record->load15;
+    bucket->tasks += record->tasks;
+}
+
+static void add_history_bucket(struct blob_buf* buf, const history_bucket* bucket) {
+    double n = bucket->samples;
+    void* cookie = blobmsg_open_table(buf, NULL);
+    blobmsg_add_u32(buf, "time", (uint32_t)(bucket->time_ms / bucket->samples / 1000));
+    blobmsg_add_u32(buf, "samples", bucket->samples);
+    blobmsg_add_double(buf, "cpu_usage", bucket->cpu_usage / n);
+    blobmsg_add_double(buf, "cpu_max", bucket->cpu_max);
+    blobmsg_add_double(buf, "mem_used", bucket->mem_used / n);
+    blobmsg_add_double(buf, "rx_bps", bucket->rx_bps / n);
+    blobmsg_add_double(buf, "tx_bps", bucket->tx_bps / n);
+    blobmsg_add_double(buf, "load1", bucket->load1 / n);
+    blobmsg_add_double(buf, "load5", bucket->load5 / n);
+    blobmsg_add_double(buf, "load15", bucket->load15 / n);
+    blobmsg_add_double(buf, "tasks", bucket->tasks / n);
+    blobmsg_close_table(buf, cookie);
+}
+
+int get_history(struct ubus_context *ctx, struct ubus_object *obj,
+        struct ubus_request_data *req, const char *method,
+        struct blob_attr *msg)
+        {
+            struct blob_attr* tb[__HISTORY_MAX];
+            blobmsg_parse(history_policy, ARRAY_SIZE(history_policy), tb, blob_data(msg), blob_len(msg));
 
+            stats_mark(STATS_SERIALISE);
             blob_buf_init(&b, 0);
 
-            void *cookie, *cookie2;
-            if (info->memory != NULL) {
-                cookie = blobmsg_open_table(&b, "memory");
-                memory_info* mem = info->memory;
-                blobmsg_add_u32(&b, "memory_total", mem->memory_total);
-                blobmsg_add_u32(&b, "memory_free", mem->memory_free);
-                blobmsg_add_u32(&b, "memory_available", mem->memory_available);
-                blobmsg_add_u32(&b, "memory_cached", mem->memory_cached);
-
-                cookie2 = blobmsg_open_table(&b, "memory_swap");
-                swap_info* swap = mem->swap_memory;
-                blobmsg_add_u32(&b, "m_swap_total", swap->swap_total);
-                blobmsg_add_u32(&b, "m_swap_free", swap->swap_free);
-                blobmsg_add_u32(&b, "m_swap_cached", swap->swap_cached);
-                blobmsg_close_table(&b, cookie2);
-                blobmsg_close_table(&b, cookie);
-            } else {
-                blobmsg_add_string(&b, "memory_msg", "failed to obtain");
+            uint64_t first, end;
+            if (!history_bounds(&first, &end)) {
+                blobmsg_add_string(&b, "history_msg", "disabled");
+                blobmsg_add_u32(&b, "requested", get_timestamp());
+                stats_mark(STATS_SEND);
+                ubus_send_reply(ctx, req, b.head);
+                return 0;
+            }
+
+            unsigned points = tb[HISTORY_COUNT] ? blobmsg_get_u32(tb[HISTORY_COUNT]) : HISTORY_POINTS;
+            if (points == 0 || points > HISTORY_MAX_POINTS)
+                points = points == 0 ? 1 : HISTORY_MAX_POINTS;
+
+            /* the newest record carries the current clock, older ones may predate an NTP step,
+             * so an open range spans what the stored records cover at the sampling interval */
+            const history_record* newest = end > first ? history_at(end - 1) : NULL;
+            uint64_t span = (end - first) * sampler_interval();
+            uint64_t to = tb[HISTORY_TO] ? (uint64_t)blobmsg_get_u32(tb[HISTORY_TO]) * 1000 + 1000 :
+                newest != NULL ? newest->time_ms + 1 : 0;
+            uint64_t from = tb[HISTORY_FROM] ? (uint64_t)blobmsg_get_u32(tb[HISTORY_FROM]) * 1000 :
+                to > span ? to - span : 0;
+
+            /* records are read in place from the mapping in ring order, which is not time order
+             * after a clock step, so they are folded into their bucket and sent in time order */
+            unsigned sent = 0, samples = 0;
+            history_bucket* buckets = from < to ? (history_bucket*) reply_buckets(points * sizeof(history_bucket)) : NULL;
+            if (buckets != NULL) {
+                uint64_t width = (to - from + points - 1) / points;
+                for (uint64_t seq = first; seq < end; seq++) {
+                    const history_record* record = history_at(seq);
+                    if (record == NULL || record->time_ms < from || record->time_ms >= to)
+                        continue;
+
+                    history_bucket_add(&buckets[(record->time_ms - from) / width], record);
+                    samples++;
+                }
+            }
+
+            void* cookie = blobmsg_open_array(&b, "points");
+            for (unsigned i = 0; buckets != NULL && i < points; i++) {
+                if (buckets[i].samples > 0) {
+                    add_history_bucket(&b, &buckets[i]);
+                    sent++;
+                }
             }
+            blobmsg_close_array(&b, cookie);
+
+            blobmsg_add_u32(&b, "point_count", sent);
+            blobmsg_add_u32(&b, "samples", samples);
+            blobmsg_add_u32(&b, "stored", (uint32_t)(end - first));
             blobmsg_add_u32(&b, "requested", get_timestamp());
+            stats_mark(STATS_SEND);
             ubus_send_reply(ctx, req, b.head);
             return 0;
         }
 
-int get_network(struct ubus_context *ctx, struct ubus_object *obj,
+static void series_bucket_add(series_bucket* bucket, uint64_t time_ms, double value) {
+    if (bucket->samples == 0 || value < bucket->min)
+        bucket->min = value;
+    if (bucket->samples == 0 || value > bucket->max)
+        bucket->max = value;
+    bucket->samples++;
+    bucket->time_ms += time_ms;
+    bucket->sum += value;
+}
+
+static void add_series_bucket(struct blob_buf* buf, const series_bucket* bucket) {
+    void* cookie = blobmsg_open_table(buf, NULL);
+    blobmsg_add_u32(buf, "time", (uint32_t)(bucket->time_ms / bucket->samples / 1000));
+    blobmsg_add_u32(buf, "samples", bucket->samples);
+    blobmsg_add_double(buf, "avg", bucket->sum / bucket->samples);
+    blobmsg_add_double(buf, "min", bucket->min);
+    blobmsg_add_double(buf, "max", bucket->max);
+    blobmsg_close_table(buf, cookie);
+}
+
+/* Unset bounds are UINT64_MAX, the range then ends at the last sample and spans what the
+ * series holds at the sampling interval, like the history */
+static void add_series(struct blob_buf* buf, const tsdb_series* series, uint64_t from, uint64_t to, unsigned points) {
+    uint64_t oldest = UINT64_MAX;
+    for (const tsdb_block* block = series->oldest; block != NULL; block = block->next) {
+        if (block->min_ms < oldest)
+            oldest = block->min_ms;
+    }
+    uint64_t span = series->samples * sampler_interval();
+    if (to == UINT64_MAX)
+        to = series->samples > 0 ? series->last_ms + 1 : 0;
+    if (from == UINT64_MAX)
+        from = to > span ? to - span : 0;
+
+    void* cookie = blobmsg_open_table(buf, NULL);
+    blobmsg_add_string(buf, "name", series->name);
+    blobmsg_add_u64(buf, "stored", series->samples);
+    blobmsg_add_u32(buf, "bytes", series->block_count * sizeof(tsdb_block));
+    if (series->samples > 0)
+        blobmsg_add_u32(buf, "oldest", (uint32_t)(oldest / 1000));
+
+    /* wall clock steps leave the samples out of time order, each lands in its own bucket */
+    unsigned sent = 0;
+    series_bucket* buckets = from < to ? (series_bucket*) reply_buckets(points * sizeof(series_bucket)) : NULL;
+    if (buckets != NULL) {
+        uint64_t width = (to - from + points - 1) / points;
+        tsdb_iter it;
+        uint64_t time_ms;
+        float value;
+        tsdb_iter_init(&it, series, from, to);
+        while (tsdb_iter_next(&it, &time_ms, &value))
+            series_bucket_add(&buckets[(time_ms - from) / width], time_ms, value);
+    }
+
+    void* cookie2 = blobmsg_open_array(buf, "points");
+    for (unsigned i = 0; buckets != NULL && i < points; i++) {
+        if (buckets[i].samples > 0) {
+            add_series_bucket(buf, &buckets[i]);
+            sent++;
+        }
+    }
+    blobmsg_close_array(buf, cookie2);
+    blobmsg_add_u32(buf, "point_count", sent);
+    blobmsg_close_table(buf, cookie);
+}
+
+int get_series(struct ubus_context *ctx, struct ubus_object *obj,
         struct ubus_request_data *req, const char *method,
         struct blob_attr *msg)
         {
-            if (info != NULL)
-                netinf_cleanup(&(info->network));
+            struct blob_attr* tb[__SERIES_MAX];
+            blobmsg_parse(series_policy, ARRAY_SIZE(series_policy), tb, blob_data(msg), blob_len(msg));
+
+            const tsdb_series* selected = NULL;
+            if (tb[SERIES_NAME]) {
+                selected = tsdb_find(blobmsg_get_string(tb[SERIES_NAME]));
+                if (selected == NULL) {
+                    blob_buf_init(&b, 0);
+                    blobmsg_add_string(&b, "error", "unknown series");
+                    stats_error();
+                    blobmsg_add_u32(&b, "requested", get_timestamp());
+                    stats_mark(STATS_SEND);
+                    ubus_send_reply(ctx, req, b.head);
+                    return 0;
+                }
+            }
+
+            unsigned points = tb[SERIES_COUNT] ? blobmsg_get_u32(tb[SERIES_COUNT]) : HISTORY_POINTS;
+            if (points == 0 || points > HISTORY_MAX_POINTS)
+                points = points == 0 ? 1 : HISTORY_MAX_POINTS;
+            uint64_t from = tb[SERIES_FROM] ? (uint64_t)blobmsg_get_u32(tb[SERIES_FROM]) * 1000 : UINT64_MAX;
+            uint64_t to = tb[SERIES_TO] ? (uint64_t)blobmsg_get_u32(tb[SERIES_TO]) * 1000 + 1000 : UINT64_MAX;
 
-            info->network = get_net_info();
+            stats_mark(STATS_SERIALISE);
             blob_buf_init(&b, 0);
 
-            void *cookie, *cookie2;
-            if (info->network != NULL) {
-                network_info* interfaces = info->network;
-                blobmsg_add_u32(&b, "interface_count", interfaces->interface_count);
-                cookie = blobmsg_open_array(&b, "interfaces");
-                for (int i = 0; i < interfaces->interface_count; i++) {
-                    cookie2 = blobmsg_open_table(&b, NULL);
-                    _network* interface = interfaces->interfaces[i];
-                    blobmsg_add_string(&b, "name", interface->ni_name);
-                    blobmsg_add_u32(&b, "flags", interface->ni_flags);
-                    blobmsg_close_table(&b, cookie2);
-                }
-                blobmsg_close_array(&b, cookie);
-            } else {
-                blobmsg_add_string(&b, "network_msg", "failed to obtain");
+            /* samples are decoded straight from the compressed blocks into the current bucket */
+            void* cookie = blobmsg_open_array(&b, "series");
+            for (const tsdb_series* s = tsdb_first(); s != NULL; s = s->next) {
+                if (selected == NULL || s == selected)
+                    add_series(&b, s, from, to, points);
             }
+            blobmsg_close_array(&b, cookie);
             blobmsg_add_u32(&b, "requested", get_timestamp());
+            stats_mark(STATS_SEND);
             ubus_send_reply(ctx, req, b.head);
             return 0;
         }
 
+/* Delta in percentage points of total utilisation */
+static bool collect_cpu_usage(struct blob_buf* buf, double* value) {
+    const cpu_usage* usage = get_cpu_usage();
+    if (!usage->valid)
+        return false;
+
+    add_cpu_usage(buf, usage);
+    *value = usage->total.usage;
+    return true;
+}
+
+/* Delta in percentage points of available memory */
+static bool collect_memory(struct blob_buf* buf, double* value) {
+    const memory_info* mem = snapshot_acquire()->info.memory;
+    if (mem == NULL) {
+        snapshot_release();
+        return false;
+    }
+
+    add_memory(buf, mem);
+    uint64_t total = mem->values[MEMINFO_MEM_TOTAL];
+    *value = total ? 100.0 * mem->values[MEMINFO_MEM_AVAILABLE] / total : 0;
+    snapshot_release();
+    return true;
+}
+
+/* Delta in percent of the combined rate of all interfaces */
+static bool collect_network(struct blob_buf* buf, double* value) {
+    const network_info* net = get_netdev_table();
+    if (net == NULL)
+        return false;
+
+    double rate = 0;
+    blobmsg_add_u32(buf, "interface_count", net->interface_count);
+    void* cookie = blobmsg_open_array(buf, "interfaces");
+    for (unsigned i = 0; i < net->interface_count; i++) {
+        void* cookie2 = blobmsg_open_table(buf, NULL);
+        add_interface(buf, &net->interfaces[i], net);
+        blobmsg_close_table(buf, cookie2);
+        rate += net->interfaces[i].rx_bps + net->interfaces[i].tx_bps;
+    }
+    blobmsg_close_array(buf, cookie);
+    *value = rate;
+    return true;
+}
+
+/* Delta in percent of the task count */
+static bool collect_processes(struct blob_buf* buf, double* value) {
+    load_info load;
+    if (!get_load_info(&load))
+        return false;
+
+    blobmsg_add_double(buf, "load1", load.load1);
+    blobmsg_add_double(buf, "load5", load.load5);
+    blobmsg_add_double(buf, "load15", load.load15);
+    blobmsg_add_u32(buf, "running", load.running);
+    blobmsg_add_u32(buf, "total", load.total);
+    *value = load.total;
+    return true;
+}
+
+static void add_signal_result(struct blob_buf* buf, int err) {
+    blobmsg_add_string(buf, "response", err == 0 ? "signal sent" : strerror(err));
+    blobmsg_add_u32(buf, "errno", err);
+}
+
 int ub_send_signal(struct ubus_context *ctx, struct ubus_object *obj,
         struct ubus_request_data *req, const char *method,
         struct blob_attr *msg) 
@@ -284,22 +1190,140 @@ int ub_send_signal(struct ubus_context *ctx, struct ubus_object *obj,
             struct blob_attr* tb[__PSIG_MAX];
             blobmsg_parse(signal_policy, ARRAY_SIZE(signal_policy), tb, blob_data(msg), blob_len(msg));
 
+            stats_mark(STATS_SERIALISE);
             blob_buf_init(&b, 0);
             if (tb[PROC_ID] && tb[SIGNAL_ID]) {
-                char* resp = send_signal(
+                int err = send_signal(
                     (int)blobmsg_get_u32(tb[PROC_ID]),
                     (int)blobmsg_get_u32(tb[SIGNAL_ID])
                 );
-                blobmsg_add_string(&b, "response", resp == NULL ? "signal sent" : resp);
+                add_signal_result(&b, err);
             } else {
                 blobmsg_add_string(&b, "error", "failed to parse provided fields");
+                stats_error();
+            }
+
+            blobmsg_add_u32(&b, "requested", get_timestamp());
+            stats_mark(STATS_SEND);
+            ubus_send_reply(ctx, req, b.head);
+            return 0;
+        }
+
+int ub_send_signal_many(struct ubus_context *ctx, struct ubus_object *obj,
+        struct ubus_request_data *req, const char *method,
+        struct blob_attr *msg)
+        {
+            struct blob_attr* tb[__PSIG_MANY_MAX];
+            blobmsg_parse(signal_many_policy, ARRAY_SIZE(signal_many_policy), tb, blob_data(msg), blob_len(msg));
+
+            stats_mark(STATS_SERIALISE);
+            blob_buf_init(&b, 0);
+            if (!tb[SIGNAL_MANY_SIG] || (!tb[SIGNAL_MANY_PIDS] && !tb[SIGNAL_MANY_NAME])) {
+                blobmsg_add_string(&b, "error", "failed to parse provided fields");
+                stats_error();
+                blobmsg_add_u32(&b, "requested", get_timestamp());
+                stats_mark(STATS_SEND);
+                ubus_send_reply(ctx, req, b.head);
+                return 0;
+            }
+
+            int signal_id = (int)blobmsg_get_u32(tb[SIGNAL_MANY_SIG]);
+            unsigned sent = 0, failed = 0;
+            void* cookie = blobmsg_open_array(&b, "results");
+            if (tb[SIGNAL_MANY_PIDS]) {
+                struct blob_attr* cur;
+                size_t rem;
+                blobmsg_for_each_attr(cur, tb[SIGNAL_MANY_PIDS], rem) {
+                    if (blobmsg_type(cur) != BLOBMSG_TYPE_INT32)
+                        continue;
+
+                    int pid = (int)blobmsg_get_u32(cur);
+                    int err = send_signal(pid, signal_id);
+                    void* cookie2 = blobmsg_open_table(&b, NULL);
+                    blobmsg_add_u32(&b, "pid", pid);
+                    add_signal_result(&b, err);
+                    blobmsg_close_table(&b, cookie2);
+                    if (err == 0)
+                        sent++;
+                    else
+                        failed++;
+                }
             }
 
+            if (tb[SIGNAL_MANY_NAME]) {
+                signal_result results[SIGNAL_MAX_MATCHES];
+                unsigned count = send_signal_by_name(blobmsg_get_string(tb[SIGNAL_MANY_NAME]),
+                    signal_id, results, ARRAY_SIZE(results));
+                for (unsigned i = 0; i < count; i++) {
+                    void* cookie2 = blobmsg_open_table(&b, NULL);
+                    blobmsg_add_u32(&b, "pid", results[i].pid);
+                    add_signal_result(&b, results[i].error);
+                    blobmsg_close_table(&b, cookie2);
+                    if (results[i].error == 0)
+                        sent++;
+                    else
+                        failed++;
+                }
+            }
+            blobmsg_close_array(&b, cookie);
+
+            blobmsg_add_u32(&b, "sent", sent);
+            blobmsg_add_u32(&b, "failed", failed);
             blobmsg_add_u32(&b, "requested", get_timestamp());
+            stats_mark(STATS_SEND);
             ubus_send_reply(ctx, req, b.head);
             return 0;
         }
 
+static void add_process(struct blob_buf* buf, const process* proc, double cpu_percent) {
+    blobmsg_add_string(buf, "process_name", proc->process_name);
+    blobmsg_add_u32(buf, "pid", proc->pid);
+    blobmsg_add_u32(buf, "ppid", proc->ppid);
+    switch (proc->state) {
+        case 'R':
+            blobmsg_add_string(buf, "state", "running");
+            break;
+        case 'D':
+            blobmsg_add_string(buf, "state", "uninterruptible sleep");
+            break;
+        case 'S':
+            blobmsg_add_string(buf, "state", "interruptible sleep");
+            break;
+        case 'T':
+            blobmsg_add_string(buf, "state", "stopped");
+            break;
+        case 'Z':
+            blobmsg_add_string(buf, "state", "zombie");
+            break;
+        default:
+            blobmsg_add_string(buf, "state", "unknown");
+            break;
+    }
+    blobmsg_add_u32(buf, "threads", proc->threads);
+    blobmsg_add_u64(buf, "rss", proc->rss);
+    blobmsg_add_u64(buf, "vsz", proc->vsz);
+    blobmsg_add_double(buf, "cpu_percent", cpu_percent);
+    blobmsg_add_u32(buf, "started", procstat_started(proc));
+}
+
+/* Details that cost a syscall or more each, only reported for single lookups */
+static void add_process_details(struct blob_buf* buf, const process* proc) {
+    int fds = procstat_fd_count(proc->pid);
+    if (fds >= 0)
+        blobmsg_add_u32(buf, "fd_count", fds);
+
+    process_io io;
+    if (procstat_io(proc->pid, &io)) {
+        void* cookie = blobmsg_open_table(buf, "io");
+        blobmsg_add_u64(buf, "rchar", io.rchar);
+        blobmsg_add_u64(buf, "wchar", io.wchar);
+        blobmsg_add_u64(buf, "read_bytes", io.read_bytes);
+        blobmsg_add_u64(buf, "write_bytes", io.write_bytes);
+        blobmsg_add_u64(buf, "cancelled_write_bytes", io.cancelled_write_bytes);
+        blobmsg_close_table(buf, cookie);
+    }
+}
+
 int ub_pid_lookup(struct ubus_context *ctx, struct ubus_object *obj,
         struct ubus_request_data *req, const char *method,
         struct blob_attr *msg)
@@ -307,39 +1331,414 @@ int ub_pid_lookup(struct ubus_context *ctx, struct ubus_object *obj,
             struct blob_attr* tb[__PLOOKUP_MAX];
             blobmsg_parse(pid_lookup_policy, ARRAY_SIZE(pid_lookup_policy), tb, blob_data(msg), blob_len(msg));
 
+            stats_mark(STATS_SERIALISE);
             blob_buf_init(&b, 0);
             if (tb[PROC_ID]) {
-                process* proc = pid_lookup(blobmsg_get_u32(tb[PROC_ID]));
-                if (proc != NULL) {
-                    blobmsg_add_string(&b, "process_name", proc->process_name);
-                    blobmsg_add_u32(&b, "pid", proc->pid);
-                    blobmsg_add_u32(&b, "ppid", proc->ppid);
-                    switch (proc->state) {
-                        case 'R':
-                            blobmsg_add_string(&b, "state", "running");
-                            break;
-                        case 'D':
-                            blobmsg_add_string(&b, "state", "uninterruptible sleep");
-                            break;
-                        case 'S':
-                            blobmsg_add_string(&b, "state", "interruptible sleep");
-                            break;
-                        case 'T':
-                            blobmsg_add_string(&b, "state", "stopped");
-                            break;
-                        case 'Z':
-                            blobmsg_add_string(&b, "state", "zombie");
-                            break;
-                        default:
-                            blobmsg_add_string(&b, "state", "unknown");
-                            break;
-                    }
-                    free(proc);
+                process proc;
+                if (pid_lookup(blobmsg_get_u32(tb[PROC_ID]), &proc)) {
+                    add_process(&b, &proc, procstat_cpu_percent(&proc));
+                    add_process_details(&b, &proc);
                 } else {
                     blobmsg_add_string(&b, "error", "failed to lookup");
+                    stats_error();
+                }
+            }
+            blobmsg_add_u32(&b, "requested", get_timestamp());
+            stats_mark(STATS_SEND);
+            ubus_send_reply(ctx, req, b.head);
+            return 0;
+        }
+
+int ub_pid_lookup_many(struct ubus_context *ctx, struct ubus_object *obj,
+        struct ubus_request_data *req, const char *method,
+        struct blob_attr *msg)
+        {
+            struct blob_attr* tb[__PLOOKUP_MANY_MAX];
+            blobmsg_parse(pid_lookup_many_policy, ARRAY_SIZE(pid_lookup_many_policy), tb, blob_data(msg), blob_len(msg));
+
+            stats_mark(STATS_SERIALISE);
+            blob_buf_init(&b, 0);
+            if (tb[PROC_IDS]) {
+                void* cookie = blobmsg_open_array(&b, "processes");
+                struct blob_attr* cur;
+                size_t rem;
+                blobmsg_for_each_attr(cur, tb[PROC_IDS], rem) {
+                    if (blobmsg_type(cur) != BLOBMSG_TYPE_INT32)
+                        continue;
+
+                    int pid = (int)blobmsg_get_u32(cur);
+                    process proc;
+                    void* cookie2 = blobmsg_open_table(&b, NULL);
+                    if (pid_lookup(pid, &proc)) {
+                        add_process(&b, &proc, procstat_cpu_percent(&proc));
+                    } else {
+                        blobmsg_add_u32(&b, "pid", pid);
+                        blobmsg_add_string(&b, "error", "failed to lookup");
+                    }
+                    blobmsg_close_table(&b, cookie2);
+                }
+                blobmsg_close_array(&b, cookie);
+            } else {
+                blobmsg_add_string(&b, "error", "failed to parse provided fields");
+                stats_error();
+            }
+            blobmsg_add_u32(&b, "requested", get_timestamp());
+            stats_mark(STATS_SEND);
+            ubus_send_reply(ctx, req, b.head);
+            return 0;
+        }
+
+int ub_top(struct ubus_context *ctx, struct ubus_object *obj,
+        struct ubus_request_data *req, const char *method,
+        struct blob_attr *msg)
+        {
+            static const char* orderings[] = {
+                [PROCSTAT_BY_CPU] = "cpu",
+                [PROCSTAT_BY_RSS] = "rss",
+                [PROCSTAT_BY_IO] = "io",
+            };
+            static process_top top[PROCSTAT_TOP_MAX];
+
+            struct blob_attr* tb[__TOP_MAX];
+            blobmsg_parse(top_policy, ARRAY_SIZE(top_policy), tb, blob_data(msg), blob_len(msg));
+
+            int by = PROCSTAT_BY_CPU;
+            if (tb[TOP_BY]) {
+                by = -1;
+                for (unsigned i = 0; i < ARRAY_SIZE(orderings); i++) {
+                    if (strcmp(orderings[i], blobmsg_get_string(tb[TOP_BY])) == 0)
+                        by = (int)i;
+                }
+            }
+            unsigned count = tb[TOP_COUNT] ? blobmsg_get_u32(tb[TOP_COUNT]) : TOP_DEFAULT_COUNT;
+
+            if (by < 0 || count == 0 || count > PROCSTAT_TOP_MAX) {
+                blob_buf_init(&b, 0);
+                blobmsg_add_string(&b, "error", "failed to parse provided fields");
+                stats_error();
+                blobmsg_add_u32(&b, "requested", get_timestamp());
+                stats_mark(STATS_SEND);
+                ubus_send_reply(ctx, req, b.head);
+                return 0;
+            }
+
+            unsigned n = procstat_top(by, count, top);
+            stats_mark(STATS_SERIALISE);
+            blob_buf_init(&b, 0);
+            blobmsg_add_string(&b, "by", orderings[by]);
+            void* cookie = blobmsg_open_array(&b, "processes");
+            for (unsigned i = 0; i < n; i++) {
+                void* cookie2 = blobmsg_open_table(&b, NULL);
+                add_process(&b, &top[i].proc, top[i].cpu_percent);
+                if (by == PROCSTAT_BY_IO)
+                    blobmsg_add_double(&b, "io_rate", top[i].io_rate);
+                blobmsg_close_table(&b, cookie2);
+            }
+            blobmsg_close_array(&b, cookie);
+            blobmsg_add_u32(&b, "requested", get_timestamp());
+            stats_mark(STATS_SEND);
+            ubus_send_reply(ctx, req, b.head);
+            return 0;
+        }
+
+static void ptree_procs_cb(const process* proc, void* priv) {
+    if (ptree_procs_count == ptree_procs_size) {
+        unsigned size = ptree_procs_size ? ptree_procs_size * 2 : PTREE_MIN_SLOTS;
+        process* procs = (process*) realloc(ptree_procs, size * sizeof(process));
+        if (procs == NULL)
+            return;
+        ptree_procs = procs;
+        ptree_procs_size = size;
+    }
+
+    if (ptree_procs_count > 0 && ptree_procs[ptree_procs_count - 1].pid > proc->pid)
+        ptree_procs_sorted = false;
+    ptree_procs[ptree_procs_count++] = *proc;
+}
+
+static int ptree_proc_cmp(const void* a, const void* b) {
+    unsigned l = ((const process*) a)->pid, r = ((const process*) b)->pid;
+    return (l > r) - (l < r);
+}
+
+static const process* ptree_proc(unsigned pid) {
+    process key = { .pid = pid };
+    return (const process*) bsearch(&key, ptree_procs, ptree_procs_count, sizeof(process), ptree_proc_cmp);
+}
+
+/* Adds the descendants below the serialised depth to the totals, walking them without recursion */
+static void add_ptree_hidden(unsigned top, double* cpu, uint64_t* rss) {
+    unsigned cur = ptree_first_child(top);
+    while (cur != 0) {
+        const process* proc = ptree_proc(cur);
+        if (proc != NULL) {
+            *cpu += procstat_cpu_percent(proc);
+            *rss += proc->rss;
+        }
+
+        unsigned next = ptree_first_child(cur);
+        while (next == 0 && cur != top) {
+            next = ptree_next_sibling(cur);
+            if (next == 0)
+                cur = ptree_parent(cur);
+        }
+        cur = next;
+    }
+}
+
+/* Serialises a process and its descendants and adds the totals of the subtree to cpu and rss */
+static void add_ptree_node(struct blob_buf* buf, unsigned pid, unsigned depth, double* cpu, uint64_t* rss) {
+    double subtree_cpu = 0;
+    uint64_t subtree_rss = 0;
+
+    const process* proc = ptree_proc(pid);
+    if (proc != NULL) {
+        subtree_cpu = procstat_cpu_percent(proc);
+        subtree_rss = proc->rss;
+        add_process(buf, proc, subtree_cpu);
+    } else {
+        blobmsg_add_u32(buf, "pid", pid);
+    }
+
+    unsigned child = ptree_first_child(pid);
+    if (child != 0 && depth >= PTREE_MAX_DEPTH) {
+        blobmsg_add_u8(buf, "truncated", true);
+        add_ptree_hidden(pid, &subtree_cpu, &subtree_rss);
+    } else if (child != 0) {
+        void* cookie = blobmsg_open_array(buf, "children");
+        for (; child != 0; child = ptree_next_sibling(child)) {
+            void* cookie2 = blobmsg_open_table(buf, NULL);
+            add_ptree_node(buf, child, depth + 1, &subtree_cpu, &subtree_rss);
+            blobmsg_close_table(buf, cookie2);
+        }
+        blobmsg_close_array(buf, cookie);
+    }
+
+    blobmsg_add_double(buf, "subtree_cpu_percent", subtree_cpu);
+    blobmsg_add_u64(buf, "subtree_rss", subtree_rss);
+    *cpu += subtree_cpu;
+    *rss += subtree_rss;
+}
+
+int ub_ptree(struct ubus_context *ctx, struct ubus_object *obj,
+        struct ubus_request_data *req, const char *method,
+        struct blob_attr *msg)
+        {
+            struct blob_attr* tb[__PTREE_MAX];
+            blobmsg_parse(ptree_policy, ARRAY_SIZE(ptree_policy), tb, blob_data(msg), blob_len(msg));
+            unsigned pid = tb[PTREE_PID] ? blobmsg_get_u32(tb[PTREE_PID]) : 0;
+
+            ptree_procs_count = 0;
+            ptree_procs_sorted = true;
+            bool indexed = ptree_update(ptree_procs_cb, NULL);
+            /* procfs lists processes in pid order, a scan is only sorted if it came out of order */
+            if (!ptree_procs_sorted)
+                qsort(ptree_procs, ptree_procs_count, sizeof(process), ptree_proc_cmp);
+
+            if (!indexed || (pid != 0 && !ptree_contains(pid))) {
+                blob_buf_init(&b, 0);
+                blobmsg_add_string(&b, "error", "failed to lookup");
+                stats_error();
+                blobmsg_add_u32(&b, "requested", get_timestamp());
+                stats_mark(STATS_SEND);
+                ubus_send_reply(ctx, req, b.head);
+                return 0;
+            }
+
+            stats_mark(STATS_SERIALISE);
+            blob_buf_init(&b, 0);
+            double cpu = 0;
+            uint64_t rss = 0;
+            void* cookie = blobmsg_open_array(&b, "processes");
+            unsigned first = pid != 0 ? pid : ptree_first_child(0);
+            for (unsigned cur = first; cur != 0; cur = pid != 0 ? 0 : ptree_next_sibling(cur)) {
+                void* cookie2 = blobmsg_open_table(&b, NULL);
+                add_ptree_node(&b, cur, 0, &cpu, &rss);
+                blobmsg_close_table(&b, cookie2);
+            }
+            blobmsg_close_array(&b, cookie);
+            blobmsg_add_u32(&b, "indexed", ptree_count());
+            blobmsg_add_u32(&b, "requested", get_timestamp());
+            stats_mark(STATS_SEND);
+            ubus_send_reply(ctx, req, b.head);
+            return 0;
+        }
+
+int get_cache_stats(struct ubus_context *ctx, struct ubus_object *obj,
+        struct ubus_request_data *req, const char *method,
+        struct blob_attr *msg)
+        {
+            struct blob_attr* tb[__CACHE_MAX];
+            blobmsg_parse(cache_policy, ARRAY_SIZE(cache_policy), tb, blob_data(msg), blob_len(msg));
+
+            if (tb[CACHE_FLUSH] && blobmsg_get_bool(tb[CACHE_FLUSH]))
+                reply_cache_invalidate_all();
+
+            stats_mark(STATS_SERIALISE);
+            blob_buf_init(&b, 0);
+            void* cookie = blobmsg_open_table(&b, "caches");
+            for (const reply_cache* c = reply_cache_first(); c != NULL; c = c->next) {
+                void* cookie2 = blobmsg_open_table(&b, c->name);
+                blobmsg_add_u32(&b, "ttl", c->ttl);
+                blobmsg_add_u32(&b, "hits", c->hits);
+                blobmsg_add_u32(&b, "misses", c->misses);
+                blobmsg_add_u8(&b, "valid", c->valid);
+                blobmsg_close_table(&b, cookie2);
+            }
+            blobmsg_close_table(&b, cookie);
+            blobmsg_add_u32(&b, "requested", get_timestamp());
+            stats_mark(STATS_SEND);
+            ubus_send_reply(ctx, req, b.head);
+            return 0;
+        }
+
+int ub_subscribe(struct ubus_context *ctx, struct ubus_object *obj,
+        struct ubus_request_data *req, const char *method,
+        struct blob_attr *msg)
+        {
+            struct blob_attr* tb[__SUBSCRIBE_MAX];
+            blobmsg_parse(subscribe_policy, ARRAY_SIZE(subscribe_policy), tb, blob_data(msg), blob_len(msg));
+
+            stats_mark(STATS_SERIALISE);
+            blob_buf_init(&b, 0);
+            unsigned groups = 0;
+            if (tb[SUBSCRIBE_GROUPS]) {
+                struct blob_attr* cur;
+                size_t rem;
+                blobmsg_for_each_attr(cur, tb[SUBSCRIBE_GROUPS], rem) {
+                    int index = blobmsg_type(cur) == BLOBMSG_TYPE_STRING ?
+                        feeds_group_index(blobmsg_get_string(cur)) : -1;
+                    if (index < 0) {
+                        blobmsg_add_string(&b, "error", "unknown metric group");
+                        stats_error();
+                        blobmsg_add_u32(&b, "requested", get_timestamp());
+                        stats_mark(STATS_SEND);
+                        ubus_send_reply(ctx, req, b.head);
+                        return 0;
+                    }
+                    groups |= 1u << index;
+                }
+            }
+            if (groups == 0)
+                groups = (1u << feeds_group_count()) - 1;
+
+            unsigned interval = tb[SUBSCRIBE_INTERVAL] ? blobmsg_get_u32(tb[SUBSCRIBE_INTERVAL]) : 0;
+            unsigned delta = tb[SUBSCRIBE_DELTA] ? blobmsg_get_u32(tb[SUBSCRIBE_DELTA]) : 0;
+            const feed* f = feeds_subscribe(groups, interval, delta);
+            if (f != NULL) {
+                blobmsg_add_string(&b, "feed", f->name);
+                void* cookie = blobmsg_open_array(&b, "groups");
+                for (unsigned i = 0; i < feeds_group_count(); i++) {
+                    if (f->groups & (1u << i))
+                        blobmsg_add_string(&b, NULL, feeds_group_name(i));
+                }
+                blobmsg_close_array(&b, cookie);
+                blobmsg_add_u32(&b, "interval", f->interval);
+                blobmsg_add_u32(&b, "delta", f->delta);
+            } else {
+                blobmsg_add_string(&b, "error", "failed to create feed");
+                stats_error();
+            }
+            blobmsg_add_u32(&b, "requested", get_timestamp());
+            stats_mark(STATS_SEND);
+            ubus_send_reply(ctx, req, b.head);
+            return 0;
+        }
+
+static void add_histogram(struct blob_buf* buf, const char* name, const histogram* h, bool buckets) {
+    void* cookie = blobmsg_open_table(buf, name);
+    blobmsg_add_u64(buf, "count", h->count);
+    blobmsg_add_u64(buf, "mean_ns", h->count ? h->sum / h->count : 0);
+    blobmsg_add_u64(buf, "p50_ns", histogram_percentile(h, 50));
+    blobmsg_add_u64(buf, "p90_ns", histogram_percentile(h, 90));
+    blobmsg_add_u64(buf, "p99_ns", histogram_percentile(h, 99));
+    blobmsg_add_u64(buf, "max_ns", h->max);
+    if (buckets) {
+        /* pairs of the exclusive upper bound in nanoseconds and the sample count */
+        void* cookie2 = blobmsg_open_array(buf, "buckets");
+        for (unsigned i = 0; i < STATS_BUCKETS; i++) {
+            if (h->buckets[i] == 0)
+                continue;
+            void* cookie3 = blobmsg_open_array(buf, NULL);
+            blobmsg_add_u64(buf, NULL, histogram_bucket_bound(i));
+            blobmsg_add_u32(buf, NULL, h->buckets[i]);
+            blobmsg_close_array(buf, cookie3);
+        }
+        blobmsg_close_array(buf, cookie2);
+    }
+    blobmsg_close_table(buf, cookie);
+}
+
+static void add_process_usage(struct blob_buf* buf) {
+    void* cookie = blobmsg_open_table(buf, "process");
+    char statm[128];
+    if (procfs_read_pid(getpid(), "statm", statm, sizeof(statm)) > 0) {
+        const char* p = statm;
+        procfs_scan_u64(&p);
+        blobmsg_add_u64(buf, "rss_kb", procfs_scan_u64(&p) * (sysconf(_SC_PAGESIZE) / 1024));
+    }
+
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        blobmsg_add_u64(buf, "max_rss_kb", usage.ru_maxrss);
+        blobmsg_add_u64(buf, "user_ms", usage.ru_utime.tv_sec * 1000ull + usage.ru_utime.tv_usec / 1000);
+        blobmsg_add_u64(buf, "system_ms", usage.ru_stime.tv_sec * 1000ull + usage.ru_stime.tv_usec / 1000);
+    }
+    blobmsg_close_table(buf, cookie);
+}
+
+int get_stats(struct ubus_context *ctx, struct ubus_object *obj,
+        struct ubus_request_data *req, const char *method,
+        struct blob_attr *msg)
+        {
+            static const char* stage_names[] = {
+                [STATS_COLLECT] = "collect",
+                [STATS_SERIALISE] = "serialise",
+                [STATS_SEND] = "send",
+            };
+
+            struct blob_attr* tb[__STATS_MAX];
+            blobmsg_parse(stats_policy, ARRAY_SIZE(stats_policy), tb, blob_data(msg), blob_len(msg));
+            bool buckets = tb[STATS_HISTOGRAMS] && blobmsg_get_bool(tb[STATS_HISTOGRAMS]);
+
+            stats_mark(STATS_SERIALISE);
+            blob_buf_init(&b, 0);
+            unsigned count;
+            const method_stats* methods = stats_methods(&count);
+            void* cookie = blobmsg_open_table(&b, "methods");
+            for (unsigned i = 0; i < count; i++) {
+                const method_stats* s = &methods[i];
+                void* cookie2 = blobmsg_open_table(&b, s->name);
+                blobmsg_add_u64(&b, "calls", s->calls);
+                blobmsg_add_u64(&b, "errors", s->errors);
+                for (const reply_cache* c = reply_cache_first(); c != NULL; c = c->next) {
+                    if (strcmp(c->name, s->name) == 0)
+                        blobmsg_add_u32(&b, "cache_hits", c->hits);
                 }
+                add_histogram(&b, "total", &s->total, buckets);
+                for (unsigned j = 0; j < __STATS_STAGE_MAX; j++)
+                    add_histogram(&b, stage_names[j], &s->stages[j], buckets);
+                blobmsg_close_table(&b, cookie2);
             }
+            blobmsg_close_table(&b, cookie);
+
+            cookie = blobmsg_open_table(&b, "collectors");
+            for (const sampler_hook* hook = sampler_first(); hook != NULL; hook = hook->next)
+                add_histogram(&b, hook->name, &hook->latency, buckets);
+            blobmsg_close_table(&b, cookie);
+
+            add_process_usage(&b);
+            blobmsg_add_u64(&b, "since_ms", (stats_now_ns() - stats_since()) / 1000000);
             blobmsg_add_u32(&b, "requested", get_timestamp());
+
+            if (tb[STATS_RESET] && blobmsg_get_bool(tb[STATS_RESET])) {
+                stats_reset();
+                reply_cache_reset_counters();
+                for (sampler_hook* hook = sampler_first(); hook != NULL; hook = hook->next)
+                    histogram_reset(&hook->latency);
+            }
+
+            stats_mark(STATS_SEND);
             ubus_send_reply(ctx, req, b.head);
             return 0;
-        }
\ No newline at end of file
+        }
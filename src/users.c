@@ -0,0 +1,130 @@
+#include "../includes/users.h"
+
+static user_list users = { 0 };
+static bool users_dirty = true;
+static struct uloop_fd utmp_watch = { .fd = -1 };
+
+/* utmp is often replaced rather than rewritten, so its directory is watched */
+static void utmp_split_path(char* dir, size_t size, const char** name) {
+    snprintf(dir, size, "%s", _PATH_UTMP);
+    char* slash = strrchr(dir, '/');
+    *name = strrchr(_PATH_UTMP, '/') + 1;
+    *slash = '\0';
+}
+
+static void utmp_watch_cb(struct uloop_fd* u, unsigned int events) {
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    const char* name;
+    char dir[128];
+    utmp_split_path(dir, sizeof(dir), &name);
+
+    ssize_t n;
+    while ((n = read(u->fd, buffer, sizeof(buffer))) > 0) {
+        for (char* p = buffer; p < buffer + n; ) {
+            struct inotify_event* event = (struct inotify_event*)p;
+            if ((event->mask & IN_Q_OVERFLOW) || (event->len > 0 && strcmp(event->name, name) == 0))
+                users_dirty = true;
+            p += sizeof(struct inotify_event) + event->len;
+        }
+    }
+}
+
+static int user_cmp(const void* a, const void* b) {
+    return strcmp((const char*)a, (const char*)b);
+}
+
+static bool user_add(const char* name, size_t len) {
+    if (users.count == users.capacity) {
+        unsigned capacity = users.capacity ? users.capacity * 2 : 4;
+        void* names = realloc(users.names, capacity * sizeof(*users.names));
+        if (names == NULL) {
+            syslog(LOG_ERR, "Failed to allocate memory for the user list!");
+            return false;
+        }
+        users.names = names;
+        users.capacity = capacity;
+    }
+
+    memcpy(users.names[users.count], name, len);
+    users.names[users.count][len] = '\0';
+    users.count++;
+    return true;
+}
+
+static void users_refresh() {
+    users.count = 0;
+
+    int fd = open(_PATH_UTMP, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return;
+
+    struct utmp records[16];
+    ssize_t n;
+    while ((n = read(fd, records, sizeof(records))) >= (ssize_t)sizeof(struct utmp)) {
+        for (size_t i = 0; i < n / sizeof(struct utmp); i++) {
+            if (records[i].ut_type != USER_PROCESS || records[i].ut_user[0] == '\0')
+                continue;
+
+            if (!user_add(records[i].ut_user, strnlen(records[i].ut_user, UT_NAMESIZE)))
+                break;
+        }
+    }
+    close(fd);
+
+    /* same output as `who | awk '{print $1}' | sort -u` */
+    qsort(users.names, users.count, sizeof(*users.names), user_cmp);
+    unsigned unique = 0;
+    for (unsigned i = 0; i < users.count; i++) {
+        if (unique > 0 && strcmp(users.names[unique - 1], users.names[i]) == 0)
+            continue;
+        if (unique != i)
+            memcpy(users.names[unique], users.names[i], sizeof(*users.names));
+        unique++;
+    }
+    users.count = unique;
+}
+
+int users_init() {
+    users_dirty = true;
+
+    utmp_watch.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (utmp_watch.fd < 0) {
+        syslog(LOG_WARNING, "Failed to initialize inotify, utmp will be read on every request");
+        return -1;
+    }
+
+    const char* name;
+    char dir[128];
+    utmp_split_path(dir, sizeof(dir), &name);
+    if (inotify_add_watch(utmp_watch.fd, dir,
+            IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM) < 0) {
+        syslog(LOG_WARNING, "Failed to watch %s, utmp will be read on every request", dir);
+        close(utmp_watch.fd);
+        utmp_watch.fd = -1;
+        return -1;
+    }
+
+    utmp_watch.cb = utmp_watch_cb;
+    uloop_fd_add(&utmp_watch, ULOOP_READ);
+    return 0;
+}
+
+const user_list* get_current_users() {
+    if (users_dirty || utmp_watch.fd < 0) {
+        users_refresh();
+        users_dirty = false;
+    }
+    return &users;
+}
+
+void users_cleanup() {
+    if (utmp_watch.fd >= 0) {
+        uloop_fd_delete(&utmp_watch);
+        close(utmp_watch.fd);
+        utmp_watch.fd = -1;
+    }
+
+    free(users.names);
+    memset(&users, 0, sizeof(users));
+    users_dirty = true;
+}